@@ -0,0 +1,288 @@
+// DictionaryBenchmark.cpp
+// Google Benchmark microbenchmarks of single HashTableDictionary operations
+// (insert, member hit, member miss, remove) at controlled load states:
+// SINGLE and DOUBLE probing, load factors 0.5 to 0.95, and tombstone
+// shares like those the LRU traces reach before compaction. Each reports
+// the time per operation, as probes_per_op the probes it took, and as
+// actual_tombstone_pct the tombstone share the table ended up with.
+//
+// Keys are pairs of words like the trace keys: the first drawn from
+// 50000_words_6770_uniq.txt, so common words come up as often as they do
+// in text, the second from 6770_uniq_words.txt. The word files are read
+// from the source directory, or from $HASH_TABLE_WORDS_DIR if set.
+//
+// BM_IdMemberHit and BM_IdMemberMiss look up sparse 64-bit ids instead, in
+// OpenAddressedSet<std::uint64_t>, in OpenAddressedSet<std::string> and in
+// HashTableDictionary, the latter two holding the ids' decimal strings.
+//
+// Usage: HashTableBenchmark [--benchmark_filter=<regex>] [other Google Benchmark flags]
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "HashTableDictionary.hpp"
+#include "OpenAddressedSet.hpp"
+
+namespace {
+
+const std::size_t TABLE_SLOTS = 131071;
+// Keys an insert or remove benchmark changes before it undoes them,
+// untimed. Undoing an insert leaves a tombstone, so BM_Insert's table
+// holds up to this many more than its tombstone_pct asks for.
+const std::size_t POOL_SIZE = 256;
+const unsigned KEY_SEED = 23;
+
+std::vector<std::string> loadWords(const std::string &fileName) {
+    const char *dir = std::getenv("HASH_TABLE_WORDS_DIR");
+    const std::string path = std::string(dir != nullptr ? dir : HASH_TABLE_WORDS_DIR) + "/" + fileName;
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Unable to open " << path << ". Set HASH_TABLE_WORDS_DIR to the directory holding it.\n";
+        exit(1);
+    }
+    std::vector<std::string> words;
+    for (std::string word; in >> word; )
+        words.push_back(word);
+    return words;
+}
+
+// Enough distinct keys to fill the table, followed by POOL_SIZE that no
+// benchmark inserts into its initial state.
+const std::vector<std::string> &benchmarkKeys() {
+    static const std::vector<std::string> keys = [] {
+        const std::vector<std::string> text = loadWords("50000_words_6770_uniq.txt");
+        const std::vector<std::string> unique = loadWords("6770_uniq_words.txt");
+        std::mt19937 generator(KEY_SEED);
+        std::uniform_int_distribution<std::size_t> pickText(0, text.size() - 1), pickUnique(0, unique.size() - 1);
+        std::unordered_set<std::string> seen;
+        std::vector<std::string> result;
+        while (result.size() < TABLE_SLOTS + POOL_SIZE) {
+            std::string key = text[pickText(generator)] + " " + unique[pickUnique(generator)];
+            if (seen.insert(key).second)
+                result.push_back(std::move(key));
+        }
+        return result;
+    }();
+    return keys;
+}
+
+// A table with load_pct% of its slots live and tombstone_pct% tombstones,
+// as given by the benchmark's arguments. Compaction is off so that the
+// state does not change under the benchmark. Keys [0, numLive) are
+// present and keys [numLive, numLive + numDead) have been removed.
+struct LoadedTable {
+    std::unique_ptr<HashTableDictionary> table;
+    std::size_t numLive = 0;
+    std::size_t numDead = 0;
+};
+
+LoadedTable loadTable(benchmark::State &state) {
+    const auto probeType = state.range(0) == 0 ? HashTableDictionary::SINGLE : HashTableDictionary::DOUBLE;
+    const auto &keys = benchmarkKeys();
+    LoadedTable loaded;
+    loaded.table = std::make_unique<HashTableDictionary>(TABLE_SLOTS, probeType, false);
+    loaded.numLive = TABLE_SLOTS * static_cast<std::size_t>(state.range(1)) / 100;
+    loaded.numDead = TABLE_SLOTS * static_cast<std::size_t>(state.range(2)) / 100;
+    for (std::size_t i = 0; i < loaded.numLive + loaded.numDead; i++)
+        loaded.table->insert(keys[i]);
+    for (std::size_t i = loaded.numLive; i < loaded.numLive + loaded.numDead; i++)
+        (void)loaded.table->remove(keys[i]);
+    state.SetLabel(HashTableDictionary::probeTypeName(probeType));
+    return loaded;
+}
+
+// Runs op on keys[0], keys[1], ... (wrapping around) once per iteration.
+// After each pass over keys, undo(key) is applied to all of them with the
+// timer paused. Probes taken by undo are not counted.
+template<typename Op, typename Undo>
+void timeOperations(benchmark::State &state, HashTableDictionary &table,
+                    const std::vector<std::string_view> &keys, Op op, Undo undo) {
+    const std::size_t count = keys.size();
+    std::int64_t probes = 0;
+    std::int64_t probesBefore = table.counters().totalProbes;
+    std::size_t next = 0;
+    for (auto _ : state) {
+        if (next == count) {
+            state.PauseTiming();
+            probes += table.counters().totalProbes - probesBefore;
+            for (std::size_t i = 0; i < count; i++)
+                undo(keys[i]);
+            probesBefore = table.counters().totalProbes;
+            next = 0;
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(op(keys[next++]));
+    }
+    probes += table.counters().totalProbes - probesBefore;
+    state.counters["probes_per_op"] = benchmark::Counter(static_cast<double>(probes),
+                                                         benchmark::Counter::kAvgIterations);
+    state.counters["actual_tombstone_pct"] =
+        100.0 * static_cast<double>(table.counters().numberOfTombstones) / static_cast<double>(table.tableSize());
+}
+
+// The keys that are never in the initial state.
+std::vector<std::string_view> absentKeys() {
+    const auto &keys = benchmarkKeys();
+    return {keys.end() - static_cast<std::ptrdiff_t>(POOL_SIZE), keys.end()};
+}
+
+// count of the live keys, spread evenly over the order they were inserted
+// in; the earliest ones tend to have the shortest probe sequences.
+std::vector<std::string_view> liveKeys(const LoadedTable &loaded, std::size_t count) {
+    const auto &keys = benchmarkKeys();
+    std::vector<std::string_view> sample;
+    count = std::min(count, loaded.numLive);
+    for (std::size_t i = 0; i < count; i++)
+        sample.emplace_back(keys[i * loaded.numLive / count]);
+    return sample;
+}
+
+void BM_Insert(benchmark::State &state) {
+    LoadedTable loaded = loadTable(state);
+    HashTableDictionary &table = *loaded.table;
+    // Removing an inserted key leaves a tombstone, which the key's next
+    // insert reuses, so only the first pass adds tombstones. It is done
+    // here, untimed, so that every timed pass starts from the same state.
+    for (std::string_view key : absentKeys()) {
+        table.insert(key);
+        (void)table.remove(key);
+    }
+    timeOperations(state, table, absentKeys(),
+                   [&](std::string_view key) { return table.insert(key); },
+                   [&](std::string_view key) { (void)table.remove(key); });
+}
+
+void BM_MemberHit(benchmark::State &state) {
+    LoadedTable loaded = loadTable(state);
+    HashTableDictionary &table = *loaded.table;
+    timeOperations(state, table, liveKeys(loaded, loaded.numLive),
+                   [&](std::string_view key) { return table.member(key); },
+                   [](std::string_view) {});
+}
+
+void BM_MemberMiss(benchmark::State &state) {
+    LoadedTable loaded = loadTable(state);
+    HashTableDictionary &table = *loaded.table;
+    timeOperations(state, table, absentKeys(),
+                   [&](std::string_view key) { return table.member(key); },
+                   [](std::string_view) {});
+}
+
+void BM_Remove(benchmark::State &state) {
+    LoadedTable loaded = loadTable(state);
+    HashTableDictionary &table = *loaded.table;
+    timeOperations(state, table, liveKeys(loaded, POOL_SIZE),
+                   [&](std::string_view key) { return table.remove(key); },
+                   [&](std::string_view key) { table.insert(key); });
+}
+
+// SINGLE (0) and DOUBLE (1) probing at each load factor, with no
+// tombstones and with the shares the LRU traces reach; the live keys and
+// tombstones together stay below the 0.95 compaction trigger.
+void LoadStates(benchmark::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"probe", "load_pct", "tombstone_pct"});
+    for (int probe : {0, 1})
+        for (int load : {50, 70, 90, 95})
+            for (int tombstones : {0, 5, 15})
+                if (load + tombstones <= 95)
+                    benchmark->Args({probe, load, tombstones});
+}
+
+const std::size_t NUM_IDS = 100000;
+
+// NUM_IDS distinct random 64-bit ids, followed by POOL_SIZE more.
+const std::vector<std::uint64_t> &sparseIds() {
+    static const std::vector<std::uint64_t> ids = [] {
+        std::mt19937_64 generator(KEY_SEED);
+        std::unordered_set<std::uint64_t> seen;
+        std::vector<std::uint64_t> result;
+        while (result.size() < NUM_IDS + POOL_SIZE) {
+            const std::uint64_t id = generator();
+            if (seen.insert(id).second)
+                result.push_back(id);
+        }
+        return result;
+    }();
+    return ids;
+}
+
+// Looks up ids[first], ..., ids[first + count - 1] (wrapping around) in a
+// set of the first NUM_IDS ids, held as the benchmark's argument selects:
+// 0 for OpenAddressedSet<std::uint64_t>, 1 for OpenAddressedSet<std::string>,
+// 2 for HashTableDictionary with DOUBLE probing at about the same load.
+// bytes_per_key counts the slot arrays only, not string bytes on the heap.
+void timeIdLookups(benchmark::State &state, std::size_t first, std::size_t count) {
+    const auto &ids = sparseIds();
+    std::vector<std::string> names;
+    for (std::uint64_t id : ids)
+        names.push_back(std::to_string(id));
+    std::size_t bytes = 0;
+    auto run = [&](auto lookup) {
+        std::size_t next = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(lookup(first + next));
+            if (++next == count)
+                next = 0;
+        }
+    };
+    switch (state.range(0)) {
+        case 0: {
+            OpenAddressedSet<std::uint64_t> set(NUM_IDS);
+            for (std::size_t i = 0; i < NUM_IDS; i++)
+                set.insert(ids[i]);
+            bytes = set.memoryBytes();
+            state.SetLabel("uint64_set");
+            run([&](std::size_t i) { return set.member(ids[i]); });
+            break;
+        }
+        case 1: {
+            OpenAddressedSet<std::string> set(NUM_IDS);
+            for (std::size_t i = 0; i < NUM_IDS; i++)
+                set.insert(names[i]);
+            bytes = set.memoryBytes();
+            state.SetLabel("string_set");
+            run([&](std::size_t i) { return set.member(names[i]); });
+            break;
+        }
+        default: {
+            OpenAddressedSet<std::uint64_t> sizing(NUM_IDS);
+            HashTableDictionary table(HashTableDictionary::nextPrime(sizing.capacity()), HashTableDictionary::DOUBLE, false);
+            for (std::size_t i = 0; i < NUM_IDS; i++)
+                table.insert(names[i]);
+            bytes = table.memoryBytes();
+            state.SetLabel("dictionary");
+            run([&](std::size_t i) { return table.member(names[i]); });
+            break;
+        }
+    }
+    state.counters["bytes_per_key"] = static_cast<double>(bytes) / static_cast<double>(NUM_IDS);
+}
+
+void BM_IdMemberHit(benchmark::State &state) {
+    timeIdLookups(state, 0, NUM_IDS);
+}
+
+void BM_IdMemberMiss(benchmark::State &state) {
+    timeIdLookups(state, NUM_IDS, POOL_SIZE);
+}
+
+}
+
+BENCHMARK(BM_Insert)->Apply(LoadStates);
+BENCHMARK(BM_MemberHit)->Apply(LoadStates);
+BENCHMARK(BM_MemberMiss)->Apply(LoadStates);
+BENCHMARK(BM_Remove)->Apply(LoadStates);
+BENCHMARK(BM_IdMemberHit)->ArgName("set")->DenseRange(0, 2);
+BENCHMARK(BM_IdMemberMiss)->ArgName("set")->DenseRange(0, 2);
+
+BENCHMARK_MAIN();
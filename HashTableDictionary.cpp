@@ -3,172 +3,530 @@
 //
 
 #include "HashTableDictionary.hpp"
+#include "Operations.hpp"
 #include<iostream>
 #include<iomanip>
 #include<algorithm>
 #include<cassert>
+#include<cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include<immintrin.h>
+#define HASH_TABLE_X86 1
+#else
+#define HASH_TABLE_X86 0
+#endif
+
+namespace {
+
+#if HASH_TABLE_X86
+// Compares 16 (SSE2) or 32 (AVX2) control bytes at p with the fingerprint.
+// The empty/deleted markers are the only bytes with the high bit set, so a
+// movemask of the raw bytes finds both; one more compare separates them.
+// The target attributes let these be compiled without -mavx2 and picked at
+// run time by bestGroupScan().
+__attribute__((target("sse2")))
+void sse2Masks(const std::uint8_t* p, std::uint8_t fp,
+               std::uint32_t& match, std::uint32_t& available, std::uint32_t& deleted) {
+    const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i empty = _mm_set1_epi8(static_cast<char>(0x80));
+    match = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(fp)))));
+    available = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, empty)));
+    deleted = static_cast<std::uint32_t>(_mm_movemask_epi8(group)) & ~available;
+}
 
-HashTableDictionary::HashTableDictionary(std::size_t large, PROBE_TYPE pType, bool doCompact, double compactionFloor):
-    TABLE_SIZE{large}, probeType{pType}, compactionTriggerEffectiveRate(compactionFloor), shouldCompact {doCompact} {
-    hashTable.resize(large);
-    hashTableMask.resize(large, AVAILABLE);
+__attribute__((target("avx2")))
+void avx2Masks(const std::uint8_t* p, std::uint8_t fp,
+               std::uint32_t& match, std::uint32_t& available, std::uint32_t& deleted) {
+    const __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i empty = _mm256_set1_epi8(static_cast<char>(0x80));
+    match = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(static_cast<char>(fp)))));
+    available = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, empty)));
+    deleted = static_cast<std::uint32_t>(_mm256_movemask_epi8(group)) & ~available;
 }
+#endif
 
-void HashTableDictionary::clear() {
-    std::cout << "Clearing hash table...\n";
-    hashTable.clear();
-    hashTableMask.clear();
+// The probe functions take either kind of key. A JoinedKey is visited a
+// piece at a time instead of being assembled.
+using JoinedKey = HashTableDictionary::JoinedKey;
 
-    hashTable.resize(TABLE_SIZE);
-    hashTableMask.resize(TABLE_SIZE, AVAILABLE);
+template<typename Visit>
+void forEachByte(std::string_view v, Visit visit) {
+    for (unsigned char c : v)
+        visit(c);
+}
 
-     numLookups = 0;
-     numDeletes = 0;
-     numInserts = 0;
+template<typename Visit>
+void forEachByte(const JoinedKey& key, Visit visit) {
+    forEachByte(key.first, visit);
+    visit(static_cast<unsigned char>(' '));
+    forEachByte(key.second, visit);
+}
 
-     numCompactions = 0;
+void copyKey(std::string_view v, char *out) {
+    std::memcpy(out, v.data(), v.size());
+}
 
-     numHits = 0;
-     numMisses = 0;
-     numFullScans = 0;
+void copyKey(const JoinedKey& key, char *out) {
+    key.copyTo(out);
+}
 
-     totalProbes = 0;
+}
 
-     numberOfActive = 0;
-     numberOfTombstones = 0;
-     maxTombstones = 0;
+HashTableDictionary::HashTableDictionary(std::size_t large, PROBE_TYPE pType, bool doCompact, double compactionFloor,
+                                         COMPACTION_MODE cMode, HASH_FUNCTION hFunction,
+                                         const slotmemory::Placement& placement):
+    TABLE_SIZE{large}, initialTableSize{large}, probeType{pType}, compactionTriggerEffectiveRate(compactionFloor), shouldCompact {doCompact},
+    compactionMode{cMode}, hashFunction{hFunction} {
+    setPlacement(placement);
+    controls.resize(large, AVAILABLE_CONTROL);
+    keys.resize(large);
+    probeDistances.resize(large, 0);
+}
+
+void HashTableDictionary::clear() {
+    std::cout << "Clearing hash table...\n";
+    TABLE_SIZE = initialTableSize;
+    controls.clear();
+    keys.clear();
+    probeDistances.clear();
+    keyArena.clear();
+    spareArena.clear();
 
-     maxValuesInTable = 0;
+    controls.resize(TABLE_SIZE, AVAILABLE_CONTROL);
+    keys.resize(TABLE_SIZE);
+    probeDistances.resize(TABLE_SIZE, 0);
+
+    migrationPhase = IDLE;
+    oldControls.clear();
+    oldKeys.clear();
+    migrationCursor = 0;
+    drainingActive = 0;
+
+    stats = Counters{};
 
 }
 
 double HashTableDictionary::effectiveLoadFactor() const {
-    return static_cast<double>(numberOfTombstones + numberOfActive) / static_cast<double>(TABLE_SIZE);
+    return static_cast<double>(stats.numberOfTombstones + stats.numberOfActive) / static_cast<double>(TABLE_SIZE);
 }
 
 
-bool HashTableDictionary::insert( const std::string&  v ) {
+bool HashTableDictionary::insert( std::string_view v) {
     // Returns whether the insert was successful.
 
-    if( numberOfActive == TABLE_SIZE) {
+    makeRoomForInsert();
+    // std::cout << v << std::endl;
+    return insertHashed(v, hashOf(v));
+}
+
+bool HashTableDictionary::insert(const JoinedKey& key) {
+    const std::string_view inPlace = joinedInPlace(key.first, key.second);
+    if (inPlace.data() != nullptr)
+        return insert(inPlace);
+    makeRoomForInsert();
+    return insertHashed(key, hashOf(key));
+}
+
+void HashTableDictionary::makeRoomForInsert() {
+    if( static_cast<std::size_t>(stats.numberOfActive) == TABLE_SIZE && growthLoadFactor > 0.0 )
+        growOrCompact();
+    if( stats.numberOfActive == TABLE_SIZE) {
         std::cout << "Table is full. This is a serious problem. Terminating\n";
         printStats();
         exit(1);
     }
-    // std::cout << v << std::endl;
-    const std::size_t idx = memberHelper(v);
-    if (hashTableMask.at(idx) == USED && hashTable.at(idx) == v)
-        return false;
-
-    assert(hashTableMask.at(idx) != USED);
+}
 
-    hashTable.at(idx) = v;
-    if (hashTableMask.at(idx) == DELETED)
-        numberOfTombstones--;
-    hashTableMask.at(idx) = USED;
-    numberOfActive++;
-    numInserts++;
+template<typename Key>
+bool HashTableDictionary::insertHashed(const Key& v, const HashedKey& hk) {
+    advanceCompaction(migrationStep);
 
-    if (maxValuesInTable < numberOfActive)
-        maxValuesInTable = numberOfActive;
+    const std::uint8_t fp = hk.fingerprint;
+    std::uint32_t distance = 0;
+    const std::size_t idx = memberHelper(v, hk, distance, stats.insertProbeLengths);
+    if (slotHolds(idx, v, fp))
+        return false;
+    if (migrationPhase == MIGRATING && drainingSlotOf(v, hk) != oldKeys.size())
+        return false;
 
+    if (probeType == ROBIN_HOOD) {
+        robinHoodPlace(idx, storeKey(v), fp, distance);
+    } else {
+        assert(!isUsed(controls[idx]));
 
-    if (shouldCompact && effectiveLoadFactor() > compactionTriggerEffectiveRate) {
-        std::cout << "Compacting the table with effective rate at: " << compactionTriggerEffectiveRate << std::endl;
-        printStats();
-        compactTable();
-        numCompactions++;
+        keys[idx] = storeKey(v);
+        probeDistances[idx] = distance;
+        if (controls[idx] == DELETED_CONTROL)
+            stats.numberOfTombstones--;
+        controls[idx] = fp;
+    }
+    stats.numberOfActive++;
+    stats.numInserts++;
+
+    if (stats.maxValuesInTable < stats.numberOfActive)
+        stats.maxValuesInTable = stats.numberOfActive;
+
+
+    // Compacting a table without tombstones cannot lower its effective load,
+    // so SINGLE_BACKSHIFT never compacts.
+    if (growthLoadFactor > 0.0 && migrationPhase != MIGRATING && effectiveLoadFactor() > growthLoadFactor) {
+        growOrCompact();
+    } else if (shouldCompact && migrationPhase != MIGRATING && stats.numberOfTombstones > 0 &&
+        effectiveLoadFactor() > compactionTriggerEffectiveRate) {
+        if (verbose) {
+            std::cout << "Compacting the table with effective rate at: " << compactionTriggerEffectiveRate << std::endl;
+            printStats();
+        }
+        if (compactionMode == INCREMENTAL)
+            beginIncrementalCompaction();
+        else
+            compactTable();
+        stats.numCompactions++;
     }
 
     return true;
 }
 
 std::size_t HashTableDictionary::size() const {
-    return numberOfActive;
+    return stats.numberOfActive;
 }
 
-bool HashTableDictionary::remove(const std::string& v) {
+bool HashTableDictionary::remove(std::string_view v) {
 //    std::cout << "In remove. Removing: " << v << std::endl;
-    auto idx = memberHelper(v);
-    if( hashTableMask.at(idx) != USED )
-        return false;
+    return removeHashed(v, hashOf(v));
+}
+
+bool HashTableDictionary::remove(const JoinedKey& key) {
+    const std::string_view inPlace = joinedInPlace(key.first, key.second);
+    return inPlace.data() != nullptr ? remove(inPlace) : removeHashed(key, hashOf(key));
+}
 
-    if (numberOfActive == TABLE_SIZE && hashTable.at(idx) != v) {
-        std::cout << "Returning from remove because table is full and the item is not in the table.\n";
+template<typename Key>
+bool HashTableDictionary::removeHashed(const Key& v, const HashedKey& hk) {
+    advanceCompaction(migrationStep);
+
+    const std::uint8_t fp = hk.fingerprint;
+    std::uint32_t distance = 0;
+    auto idx = memberHelper(v, hk, distance, stats.deleteProbeLengths);
+    if( !slotHolds(idx, v, fp) ) {
+        if (migrationPhase == MIGRATING) {
+            // The key may not have been migrated yet.
+            const std::size_t oldIdx = drainingSlotOf(v, hk);
+            if (oldIdx != oldKeys.size()) {
+                releaseKey(oldKeys[oldIdx]);
+                oldControls[oldIdx] = DELETED_CONTROL;
+                drainingActive--;
+                stats.numberOfActive--;
+                stats.numDeletes++;
+                return true;
+            }
+        }
+        if (stats.numberOfActive == TABLE_SIZE && isUsed(controls[idx]))
+            std::cout << "Returning from remove because table is full and the item is not in the table.\n";
         return false;
     }
 
-    numberOfTombstones++;
-    maxTombstones = std::max(numberOfTombstones, maxTombstones);
-    hashTableMask.at(idx) = DELETED;
-    numberOfActive--;
-    numDeletes++;
+    releaseKey(keys[idx]);
+    if (probeType == SINGLE_BACKSHIFT || probeType == ROBIN_HOOD) {
+        backwardShiftFrom(idx);
+    } else {
+        stats.numberOfTombstones++;
+        stats.maxTombstones = std::max(stats.numberOfTombstones, stats.maxTombstones);
+        controls[idx] = DELETED_CONTROL;
+    }
+    stats.numberOfActive--;
+    stats.numDeletes++;
+
+    // Only the backward-shift modes depend on this; the others also get their
+    // arena cleaned whenever the table is rebuilt.
+    if (keyArena.deadBytes() > TABLE_SIZE && 2 * keyArena.deadBytes() > keyArena.reservedBytes())
+        compactArena();
 
     return true;
 }
 
-void HashTableDictionary::compactTable() {
+void HashTableDictionary::backwardShiftFrom(std::size_t hole) {
+    // Walks the rest of the cluster after the removed slot. An entry can fill
+    // the hole when the hole lies between its home slot and where it sits now;
+    // the slot it leaves becomes the new hole. The cluster ends at an
+    // AVAILABLE cell, since these probe types never create DELETED ones.
+    controls[hole] = AVAILABLE_CONTROL;
+    std::size_t idx = advance(hole, 1);
+    while (isUsed(controls[idx])) {
+        const std::size_t distanceToHole = idx >= hole ? idx - hole : idx + TABLE_SIZE - hole;
+        if (probeDistances[idx] >= distanceToHole) {
+            keys[hole] = keys[idx];
+            probeDistances[hole] = probeDistances[idx] - static_cast<std::uint32_t>(distanceToHole);
+            controls[hole] = controls[idx];
+            controls[idx] = AVAILABLE_CONTROL;
+            hole = idx;
+        } else if (probeType == ROBIN_HOOD) {
+            // Robin Hood keeps a cluster ordered by home slot, so nothing
+            // past an entry that cannot move can move either.
+            break;
+        }
+        idx = advance(idx, 1);
+    }
+}
 
-    if (hashTable.size() == 0)
+void HashTableDictionary::robinHoodPlace(std::size_t idx, KeySlot slot, std::uint8_t fp, std::uint32_t distance) {
+    // idx is where the lookup stopped: an AVAILABLE cell or the first entry
+    // closer to its home than the new key is to its own. The new key takes
+    // that slot and the entry it displaces continues down the run, doing the
+    // same.
+    while (isUsed(controls[idx])) {
+        if (probeDistances[idx] < distance) {
+            std::swap(slot, keys[idx]);
+            std::swap(fp, controls[idx]);
+            std::swap(distance, probeDistances[idx]);
+        }
+        idx = advance(idx, 1);
+        distance++;
+    }
+    keys[idx] = slot;
+    probeDistances[idx] = distance;
+    controls[idx] = fp;
+}
+
+void HashTableDictionary::setGrowthLoadFactor(double loadFactor) {
+    growthLoadFactor = std::min(std::max(loadFactor, 0.0), 0.99);
+}
+
+std::size_t HashTableDictionary::nextPrime(std::size_t n) {
+    auto isPrime = [](std::size_t c) {
+        if (c < 2) return false;
+        for (std::size_t d = 2; d * d <= c; d++)
+            if (c % d == 0) return false;
+        return true;
+    };
+    while (!isPrime(n))
+        n++;
+    return n;
+}
+
+void HashTableDictionary::growOrCompact() {
+    // Called once the live keys plus tombstones pass growthLoadFactor. When
+    // most of that is tombstones, rebuilding at the same size is enough;
+    // otherwise the capacity roughly doubles, so each key is moved O(1) times
+    // on average over the life of the table.
+
+    if (static_cast<double>(stats.numberOfActive) <= 0.75 * growthLoadFactor * static_cast<double>(TABLE_SIZE)) {
+        if (compactionMode == INCREMENTAL)
+            beginIncrementalCompaction();
+        else
+            compactTable();
+        stats.numCompactions++;
         return;
+    }
+
+    // An incremental compaction in flight is finished first; its spare arrays
+    // are the wrong size afterwards, so they are released.
+    if (migrationPhase != IDLE)
+        advanceCompaction(2 * oldControls.size());
+    oldControls.clear();
+    oldKeys.clear();
+
+    // Primes keep every double-hashing step coprime with the table size.
+    const std::size_t newSize = nextPrime(2 * TABLE_SIZE + 1);
+    if (verbose)
+        std::cout << "Growing the table from " << TABLE_SIZE << " to " << newSize << " slots." << std::endl;
+    rehashInto(newSize);
+    stats.numGrowths++;
+    stats.numGrowthRehashed += stats.numberOfActive;
+}
+
+void HashTableDictionary::compactTable() {
 
-    std::vector<std::string> newTable(hashTable.size());
-    std::vector<ELEMENT_STATUS> newMask(hashTableMask.size(), AVAILABLE);
+    if (keys.size() == 0)
+        return;
 
     /*
     std::cout << "Before compacting the table:\n";
-    std::cout << "\tNumber of active cells: " << numberOfActive << std::endl;
-    std::cout << "\tNumber of tombstone cells: " << numberOfTombstones << std::endl;
-    std::cout << "\tNumber of available cells: " << hashTable.size()-numberOfTombstones-numberOfActive << std::endl;
+    std::cout << "\tNumber of active cells: " << stats.numberOfActive << std::endl;
+    std::cout << "\tNumber of tombstone cells: " << stats.numberOfTombstones << std::endl;
+    std::cout << "\tNumber of available cells: " << keys.size()-stats.numberOfTombstones-stats.numberOfActive << std::endl;
     std::cout << "\tEffective load factor: " << effectiveLoadFactor() << std::endl;
     */
 
-    beforeCompaction.clear();
-    afterCompaction.clear();
-    for (std::size_t i = 0; i < hashTableMask.size(); i++)
-        if (hashTableMask[i] == USED || hashTableMask[i] == DELETED)
-            beforeCompaction.push_back('1');
-        else beforeCompaction.push_back('0');
-
-    auto curNumProbes = totalProbes;
-    auto curNumInserts = numInserts;
-    hashTable.swap(newTable);
-    hashTableMask.swap(newMask);
-    numberOfActive = 0;
-    numberOfTombstones = 0;
-
-    for (std::size_t i = 0; i < newTable.size(); i++) {
-        if (newMask.at(i) == USED)
-            insert(newTable.at(i));
-    }
-    numInserts = curNumInserts;
-    totalProbes = curNumProbes;
+    if (verbose)
+        recordOccupancy(beforeCompaction);
 
-    for (std::size_t i = 0; i < hashTableMask.size(); i++)
-        if (hashTableMask[i] == USED || hashTableMask[i] == DELETED)
-            afterCompaction.push_back('1');
-        else afterCompaction.push_back('0');
+    rehashInto(TABLE_SIZE);
 
+    if (verbose)
+        recordOccupancy(afterCompaction);
 
     /*
     std::cout << "\nAfter compacting the table:\n";
-    std::cout << "\tNumber of active cells: " << numberOfActive << std::endl;
-    std::cout << "\tNumber of tombstone cells: " << numberOfTombstones << std::endl;
-    std::cout << "\tNumber of available cells: " << hashTable.size()-numberOfTombstones-numberOfActive << std::endl;
+    std::cout << "\tNumber of active cells: " << stats.numberOfActive << std::endl;
+    std::cout << "\tNumber of tombstone cells: " << stats.numberOfTombstones << std::endl;
+    std::cout << "\tNumber of available cells: " << keys.size()-stats.numberOfTombstones-stats.numberOfActive << std::endl;
     std::cout << "\tEffective load factor: " << effectiveLoadFactor() << std::endl;
     */
 
 }
 
+void HashTableDictionary::setPlacement(const slotmemory::Placement& placement) {
+    slotPlacement = placement;
+    controls.setPlacement(placement);
+    keys.setPlacement(placement);
+    probeDistances.setPlacement(placement);
+    oldControls.setPlacement(placement);
+    oldKeys.setPlacement(placement);
+}
+
+void HashTableDictionary::rehashInto(std::size_t newSize) {
+    SlotArray<std::uint8_t> newControls;
+    SlotArray<KeySlot> newKeys;
+    newControls.setPlacement(slotPlacement);
+    newKeys.setPlacement(slotPlacement);
+    newControls.resize(newSize, AVAILABLE_CONTROL);
+    newKeys.resize(newSize);
+
+    controls.swap(newControls);
+    keys.swap(newKeys);
+    probeDistances.resize(newSize, 0);
+    TABLE_SIZE = newSize;
+    stats.numberOfTombstones = 0;
+
+    // Key cells are copied as they are; long keys stay where they are in the arena.
+    for (std::size_t i = 0; i < newKeys.size(); i++) {
+        if (isUsed(newControls[i]))
+            placeRehashed(newKeys[i]);
+    }
+    if (keyArena.deadBytes() > 0)
+        compactArena();
+}
+
+void HashTableDictionary::placeRehashed(const KeySlot& slot) {
+    // Places a key that is known not to be in the current arrays. Like the
+    // re-inserts of the original compaction, these probes are not counted.
+    const HashedKey hk = hashOf(keyAt(slot));
+    const std::uint8_t fp = hk.fingerprint;
+    std::size_t idx = hk.home;
+    if (probeType == ROBIN_HOOD) {
+        robinHoodPlace(idx, slot, fp, 0);
+        return;
+    }
+    const std::size_t step = hk.step;
+    std::uint32_t distance = 0;
+    while (isUsed(controls[idx])) {
+        idx = advance(idx, step);
+        distance++;
+    }
+
+    if (controls[idx] == DELETED_CONTROL)
+        stats.numberOfTombstones--;
+    keys[idx] = slot;
+    probeDistances[idx] = distance;
+    controls[idx] = fp;
+}
+
+void HashTableDictionary::recordOccupancy(std::vector<char>& map) const {
+    map.clear();
+    for (std::size_t i = 0; i < controls.size(); i++)
+        if (controls[i] != AVAILABLE_CONTROL)
+            map.push_back('1');
+        else map.push_back('0');
+}
+
+void HashTableDictionary::beginIncrementalCompaction() {
+    // A scrub still in progress is finished here; it only resets mask cells.
+    if (migrationPhase == SCRUBBING)
+        advanceCompaction(oldControls.size());
+
+    if (verbose)
+        recordOccupancy(beforeCompaction);
+
+    // The first compaction allocates the spare arrays; later ones reuse them.
+    if (oldControls.size() != TABLE_SIZE) {
+        oldControls.assign(TABLE_SIZE, AVAILABLE_CONTROL);
+        oldKeys.resize(TABLE_SIZE);
+    }
+
+    controls.swap(oldControls);
+    keys.swap(oldKeys);
+
+    drainingActive = stats.numberOfActive;
+    stats.numberOfTombstones = 0;
+    migrationCursor = 0;
+    migrationPhase = MIGRATING;
+}
+
+void HashTableDictionary::advanceCompaction(std::size_t budget) {
+    if (migrationPhase == IDLE)
+        return;
+
+    if (migrationPhase == MIGRATING) {
+        for (; budget > 0 && migrationCursor < oldKeys.size() && drainingActive > 0; budget--, migrationCursor++) {
+            if (!isUsed(oldControls[migrationCursor]))
+                continue;
+            placeRehashed(oldKeys[migrationCursor]);
+            // Leave a tombstone so that unmigrated keys further down this
+            // probe sequence stay reachable.
+            oldControls[migrationCursor] = DELETED_CONTROL;
+            drainingActive--;
+        }
+        if (migrationCursor < oldKeys.size() && drainingActive > 0)
+            return;
+
+        if (verbose)
+            recordOccupancy(afterCompaction);
+        migrationPhase = SCRUBBING;
+        migrationCursor = 0;
+    }
+
+    // Scrubbing only resets control bytes, so it is given a larger share of
+    // the budget.
+    budget *= 4;
+    const std::size_t end = std::min(oldControls.size(), migrationCursor + budget);
+    std::fill(oldControls.begin() + static_cast<std::ptrdiff_t>(migrationCursor),
+              oldControls.begin() + static_cast<std::ptrdiff_t>(end), AVAILABLE_CONTROL);
+    migrationCursor = end;
+    if (migrationCursor == oldControls.size())
+        migrationPhase = IDLE;
+}
+
+template<typename Key>
+std::size_t HashTableDictionary::drainingSlotOf(const Key& v, const HashedKey& hk) {
+    // Looks v up among the not-yet-migrated keys. Returns oldKeys.size() if absent.
+    if (drainingActive == 0)
+        return oldKeys.size();
+
+    std::int64_t numProbesForThisItem = 0;
+    const std::size_t idx = findDrainingSlot(v, hk, numProbesForThisItem);
+    stats.totalProbes += numProbesForThisItem;
+    stats.totalProbesSquared += numProbesForThisItem * numProbesForThisItem;
+    stats.numProbeSequences++;
+    return idx;
+}
+
+template<typename Key>
+std::size_t HashTableDictionary::findDrainingSlot(const Key& v, const HashedKey& hk,
+                                                  std::int64_t& numProbes) const {
+    const std::uint8_t fp = hk.fingerprint;
+    std::size_t idx = hk.home;
+    const std::size_t step = hk.step;
+    std::size_t numProbesForThisItem = 1;
+    while( numProbesForThisItem < TABLE_SIZE && oldControls[idx] != AVAILABLE_CONTROL &&
+           !(oldControls[idx] == fp && v == keyAt(oldKeys[idx])) ) {
+        idx = advance(idx, step);
+        numProbesForThisItem++;
+    }
+    numProbes = static_cast<std::int64_t>(numProbesForThisItem);
+    return oldControls[idx] == fp && v == keyAt(oldKeys[idx]) ? idx : oldKeys.size();
+}
+
 void HashTableDictionary::printActiveDeleteMap() {
     std::cout << (shouldCompact ? "compaction_on " : "compaction_off ");
-    std::cout << (probeType == SINGLE ? "single_probing " : "double_probing ");
+    std::cout << probeTypeName(probeType) << "_probing ";
     std::cout << TABLE_SIZE << std::endl;
 
-    for (std::size_t i = 0; i < hashTableMask.size(); i++) {
+    for (std::size_t i = 0; i < controls.size(); i++) {
         if (i % 100 == 0)
             std::cout << std::endl;
-        if ( hashTableMask.at(i) == USED)
+        if ( isUsed(controls.at(i)) )
             std::cout << '1';
         else
             std::cout << '0';
@@ -180,7 +538,7 @@ void HashTableDictionary::printActiveDeleteMap() {
 void HashTableDictionary::printBeforeAndAfterCompactionMaps() {
 
     std::cout << (shouldCompact ? "compaction_on " : "compaction_off ");
-    std::cout << (probeType == SINGLE ? "single_probing " : "double_probing ");
+    std::cout << probeTypeName(probeType) << "_probing ";
     std::cout << TABLE_SIZE << std::endl;
 
     for (std::size_t i = 0; i < beforeCompaction.size(); i++) {
@@ -199,39 +557,350 @@ void HashTableDictionary::printBeforeAndAfterCompactionMaps() {
 
 }
 
-std::size_t HashTableDictionary::memberHelper(const std::string& v) {
+HashTableDictionary::ELEMENT_STATUS HashTableDictionary::statusAt(std::size_t idx) const {
+    const std::uint8_t control = controls.at(idx);
+    return isUsed(control) ? USED : control == DELETED_CONTROL ? DELETED : AVAILABLE;
+}
 
-    std::size_t idx = primaryHashFunction( v );
-    std::size_t step = secondaryHashFunction( v );
-    std::int64_t numProbesForThisItem = 1;  // Accounting for the fact that the while loop's condition tests the table.
-    std::size_t firstDeleteIdx = hashTable.size();
+std::string_view HashTableDictionary::keyAt(const KeySlot& slot) const {
+    if (slot.length != KeySlot::IN_ARENA)
+        return {slot.bytes, slot.length};
+    KeyArena::Handle handle;
+    std::uint32_t length;
+    std::memcpy(&handle, slot.bytes, sizeof(handle));
+    std::memcpy(&length, slot.bytes + sizeof(handle), sizeof(length));
+    return keyArena.view(handle, length);
+}
 
-    while( numProbesForThisItem < TABLE_SIZE && hashTableMask.at(idx) != AVAILABLE &&
-            ( hashTableMask.at(idx) == DELETED || hashTable.at(idx) != v ) ) {
-        if( hashTableMask.at(idx) == DELETED && firstDeleteIdx == hashTable.size() ) {
-            firstDeleteIdx = idx;
-        }
-        idx = (idx + step) % TABLE_SIZE;
-        numProbesForThisItem++;
+template<typename Key>
+HashTableDictionary::KeySlot HashTableDictionary::storeKey(const Key& v) {
+    KeySlot slot{};
+    if (v.size() <= KeySlot::INLINE_CAPACITY) {
+        copyKey(v, slot.bytes);
+        slot.length = static_cast<std::uint8_t>(v.size());
+        return slot;
     }
+    const KeyArena::Handle handle = keyArena.store(v.size(), [&v](char *out) { copyKey(v, out); });
+    const auto length = static_cast<std::uint32_t>(v.size());
+    std::memcpy(slot.bytes, &handle, sizeof(handle));
+    std::memcpy(slot.bytes + sizeof(handle), &length, sizeof(length));
+    slot.length = KeySlot::IN_ARENA;
+    return slot;
+}
+
+void HashTableDictionary::releaseKey(const KeySlot& slot) {
+    if (slot.length != KeySlot::IN_ARENA)
+        return;
+    KeyArena::Handle handle;
+    std::uint32_t length;
+    std::memcpy(&handle, slot.bytes, sizeof(handle));
+    std::memcpy(&length, slot.bytes + sizeof(handle), sizeof(length));
+    keyArena.release(handle, length);
+}
+
+void HashTableDictionary::compactArena() {
+    // Copies the live long keys, including not-yet-migrated ones, into the
+    // spare arena, points their cells at the new copies and swaps the arenas.
+    spareArena.clear();
+    auto relocate = [&](const SlotArray<std::uint8_t>& ctrl, SlotArray<KeySlot>& cells) {
+        for (std::size_t i = 0; i < cells.size(); i++) {
+            if (!isUsed(ctrl[i]) || cells[i].length != KeySlot::IN_ARENA)
+                continue;
+            const KeyArena::Handle handle = spareArena.store(keyAt(cells[i]));
+            std::memcpy(cells[i].bytes, &handle, sizeof(handle));
+        }
+    };
+    relocate(controls, keys);
+    if (migrationPhase == MIGRATING)
+        relocate(oldControls, oldKeys);
+    std::swap(keyArena, spareArena);
+}
+
+std::size_t HashTableDictionary::memoryBytes() const {
+    return (controls.capacity() + oldControls.capacity()) * sizeof(std::uint8_t) +
+           (keys.capacity() + oldKeys.capacity()) * sizeof(KeySlot) +
+           probeDistances.capacity() * sizeof(std::uint32_t) +
+           keyArena.reservedBytes() + spareArena.reservedBytes();
+}
+
+template<typename Key>
+bool HashTableDictionary::slotHolds(std::size_t idx, const Key& v, std::uint8_t fp) const {
+    // The control byte holds a 7-bit fingerprint, so almost every
+    // non-matching slot is rejected without reading its key cell.
+    return controls[idx] == fp && v == keyAt(keys[idx]);
+}
+
+template<typename Key>
+std::size_t HashTableDictionary::memberHelper(const Key& v, const HashedKey& hk, std::uint32_t& distance,
+                                              LengthHistogram& probeLengths) {
+    // Returns the slot holding v or, if v is absent, the slot an insert should
+    // use; distance is set to that slot's number of steps from v's home slot.
+
+    std::int64_t numProbesForThisItem = 0;
+    const std::size_t idx = findSlot(v, hk, distance, numProbesForThisItem);
     // std::cout << std::setw(6) << numComparisons << " comps\n";
-    totalProbes += numProbesForThisItem;
+    stats.totalProbes += numProbesForThisItem;
+    stats.totalProbesSquared += numProbesForThisItem * numProbesForThisItem;
+    stats.numProbeSequences++;
+    probeLengths[lengthBucket(static_cast<std::uint64_t>(numProbesForThisItem))]++;
     if (numProbesForThisItem == TABLE_SIZE) {
-        numFullScans++;
+        stats.numFullScans++;
+    }
+    return idx;
+}
+
+template<typename Key>
+std::size_t HashTableDictionary::findSlot(const Key& v, const HashedKey& hk, std::uint32_t& distance,
+                                          std::int64_t& numProbes) const {
+    // memberHelper without the bookkeeping: numProbes is set to the number of
+    // slots examined.
+    const std::uint8_t fp = hk.fingerprint;
+    std::size_t idx = hk.home;
+    std::size_t step = hk.step;
+    std::int64_t numProbesForThisItem = 1;  // Accounting for the fact that the while loop's condition tests the table.
+    std::size_t firstDeleteIdx = keys.size();
+    std::uint32_t firstDeleteDistance = 0;
+
+    if (step == 1 && probeType != ROBIN_HOOD && groupScan != SCALAR) {
+        idx = groupScanFrom(v, fp, idx, numProbesForThisItem, firstDeleteIdx, firstDeleteDistance);
+    } else {
+        // Robin Hood lookups stop at the first entry that is closer to its home
+        // than v would be here: v would have displaced it on insert.
+        while( numProbesForThisItem < TABLE_SIZE && controls[idx] != AVAILABLE_CONTROL &&
+                !slotHolds(idx, v, fp) &&
+                !(probeType == ROBIN_HOOD && probeDistances[idx] < numProbesForThisItem - 1) ) {
+            if( controls[idx] == DELETED_CONTROL && firstDeleteIdx == keys.size() ) {
+                firstDeleteIdx = idx;
+                firstDeleteDistance = static_cast<std::uint32_t>(numProbesForThisItem - 1);
+            }
+            idx = advance(idx, step);
+            numProbesForThisItem++;
+        }
+    }
+    numProbes = numProbesForThisItem;
+    if (!slotHolds(idx, v, fp) && firstDeleteIdx != keys.size()) {
+        distance = firstDeleteDistance;
+        return firstDeleteIdx;
+    }
+    distance = static_cast<std::uint32_t>(numProbesForThisItem - 1);
+    return idx;
+}
+
+template<typename Key>
+std::size_t HashTableDictionary::groupScanFrom(const Key& v, std::uint8_t fp, std::size_t idx,
+                                               std::int64_t& numProbes, std::size_t& firstDeleteIdx,
+                                               std::uint32_t& firstDeleteDistance) const {
+    // The linear-probing loop of memberHelper, one group of control bytes at
+    // a time. It stops at the same slot and reports the same probe count:
+    // the first AVAILABLE slot or key match, or the slot TABLE_SIZE - 1 steps
+    // from home. A group never wraps past the end of the table.
+    const std::size_t groupWidth = groupScan == AVX2 ? 32 : 16;
+    const std::size_t lastOffset = TABLE_SIZE - 1;
+    std::size_t offset = 0;
+    while (offset < lastOffset) {
+        const std::size_t width = std::min({groupWidth, TABLE_SIZE - idx, lastOffset - offset});
+        const GroupMasks masks = groupMasks(idx, width, fp);
+
+        std::uint32_t stop = masks.available;
+        for (std::uint32_t candidates = masks.match; candidates != 0; candidates &= candidates - 1) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctz(candidates));
+            if ((stop & ((1u << bit) - 1)) != 0)
+                break;      // an earlier AVAILABLE slot ends the probe first
+            if (v == keyAt(keys[idx + bit])) {
+                stop |= 1u << bit;
+                break;
+            }
+        }
+
+        const std::uint32_t beforeStop = stop != 0 ? (stop & (0u - stop)) - 1 : ~0u;
+        if (firstDeleteIdx == keys.size() && (masks.deleted & beforeStop) != 0) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctz(masks.deleted & beforeStop));
+            firstDeleteIdx = idx + bit;
+            firstDeleteDistance = static_cast<std::uint32_t>(offset + bit);
+        }
+        if (stop != 0) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctz(stop));
+            numProbes = static_cast<std::int64_t>(offset + bit + 1);
+            return idx + bit;
+        }
+        offset += width;
+        idx = advance(idx, width);
+    }
+    numProbes = static_cast<std::int64_t>(TABLE_SIZE);
+    return idx;
+}
+
+HashTableDictionary::GroupMasks HashTableDictionary::groupMasks(std::size_t idx, std::size_t width,
+                                                                std::uint8_t fp) const {
+    const std::uint32_t widthMask = width >= 32 ? ~0u : (1u << width) - 1;
+    GroupMasks masks{0, 0, 0};
+#if HASH_TABLE_X86
+    // Only a full vector load that stays inside the array is vectorized; the
+    // short group at the end of the table is done a byte at a time.
+    if (groupScan == AVX2 && idx + 32 <= controls.size()) {
+        avx2Masks(controls.data() + idx, fp, masks.match, masks.available, masks.deleted);
+    } else if (groupScan != SCALAR && idx + 16 <= controls.size() && width <= 16) {
+        sse2Masks(controls.data() + idx, fp, masks.match, masks.available, masks.deleted);
+    } else
+#endif
+    {
+        for (std::size_t i = 0; i < width; i++) {
+            const std::uint8_t control = controls[idx + i];
+            masks.match |= static_cast<std::uint32_t>(control == fp) << i;
+            masks.available |= static_cast<std::uint32_t>(control == AVAILABLE_CONTROL) << i;
+            masks.deleted |= static_cast<std::uint32_t>(control == DELETED_CONTROL) << i;
+        }
+    }
+    masks.match &= widthMask;
+    masks.available &= widthMask;
+    masks.deleted &= widthMask;
+    return masks;
+}
+
+HashTableDictionary::GROUP_SCAN HashTableDictionary::bestGroupScan() {
+    static const GROUP_SCAN best = [] {
+#if HASH_TABLE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return SSE2;
+#endif
+        return SCALAR;
+    }();
+    return best;
+}
+
+std::string HashTableDictionary::groupScanName(GROUP_SCAN scan) {
+    switch (scan) {
+        case SCALAR:
+            return "scalar";
+        case SSE2:
+            return "sse2";
+        case AVX2:
+            return "avx2";
     }
-    return hashTableMask.at(idx) == USED && hashTable.at(idx) == v ? idx : (firstDeleteIdx != hashTable.size() ? firstDeleteIdx : idx);
+    return "unknown";
 }
 
-bool HashTableDictionary::member(const std::string& v )  {
+void HashTableDictionary::JoinedKey::copyTo(char *out) const {
+    out = std::copy(first.begin(), first.end(), out);
+    *out++ = ' ';
+    std::copy(second.begin(), second.end(), out);
+}
+
+bool HashTableDictionary::JoinedKey::operator==(std::string_view key) const {
+    return key.size() == size() && key.substr(0, first.size()) == first && key[first.size()] == ' ' &&
+           key.substr(first.size() + 1) == second;
+}
+
+bool HashTableDictionary::member(std::string_view v)  {
     // Returns true if v a member. Otherwise, it returns false
 
-    auto idx = memberHelper(v);
-    numLookups++;
-    return  hashTableMask.at(idx) == USED && hashTable.at(idx) == v;
+    return memberHashed(v, hashOf(v));
+}
+
+bool HashTableDictionary::member(const JoinedKey& key) {
+    const std::string_view inPlace = joinedInPlace(key.first, key.second);
+    return inPlace.data() != nullptr ? member(inPlace) : memberHashed(key, hashOf(key));
+}
+
+template<typename Key>
+bool HashTableDictionary::memberHashed(const Key& v, const HashedKey& hk) {
+    std::uint32_t distance = 0;
+    auto idx = memberHelper(v, hk, distance, stats.lookupProbeLengths);
+    stats.numLookups++;
+    const bool found = slotHolds(idx, v, hk.fingerprint) ||
+                       (migrationPhase == MIGRATING && drainingSlotOf(v, hk) != oldKeys.size());
+    if (found)
+        stats.numHits++;
+    else
+        stats.numMisses++;
+    return found;
+}
+
+bool HashTableDictionary::contains(std::string_view v) const {
+    return containsKey(v);
+}
+
+bool HashTableDictionary::contains(const JoinedKey& key) const {
+    const std::string_view inPlace = joinedInPlace(key.first, key.second);
+    return inPlace.data() != nullptr ? containsKey(inPlace) : containsKey(key);
+}
+
+template<typename Key>
+bool HashTableDictionary::containsKey(const Key& v) const {
+    const HashedKey hk = hashOf(v);
+    std::uint32_t distance = 0;
+    std::int64_t numProbes = 0;
+    if (slotHolds(findSlot(v, hk, distance, numProbes), v, hk.fingerprint))
+        return true;
+    return migrationPhase == MIGRATING && drainingActive > 0 &&
+           findDrainingSlot(v, hk, numProbes) != oldKeys.size();
+}
+
+std::size_t HashTableDictionary::insertBatch(const std::string_view* vs, std::size_t count, bool* results) {
+    return resolveBatch(vs, count, results, [this](std::string_view v, const HashedKey& hk) {
+        // Growing changes TABLE_SIZE, and with it every key's probe sequence.
+        const std::size_t hashedFor = TABLE_SIZE;
+        makeRoomForInsert();
+        return insertHashed(v, TABLE_SIZE == hashedFor ? hk : hashOf(v));
+    });
+}
+
+std::size_t HashTableDictionary::removeBatch(const std::string_view* vs, std::size_t count, bool* results) {
+    return resolveBatch(vs, count, results, [this](std::string_view v, const HashedKey& hk) {
+        return removeHashed(v, hk);
+    });
+}
+
+std::size_t HashTableDictionary::memberBatch(const std::string_view* vs, std::size_t count, bool* results) {
+    return resolveBatch(vs, count, results, [this](std::string_view v, const HashedKey& hk) {
+        return memberHashed(v, hk);
+    });
+}
+
+template<typename Resolve>
+std::size_t HashTableDictionary::resolveBatch(const std::string_view* vs, std::size_t count, bool* results,
+                                              Resolve resolve) {
+    // Hashes and prefetches up to PREFETCH_BATCH keys, then runs resolve on
+    // each of them in order. An insert earlier in the batch may grow the
+    // table; the keys after it are then hashed again.
+    HashedKey hashed[PREFETCH_BATCH];
+    std::size_t numTrue = 0;
+    for (std::size_t first = 0; first < count; first += PREFETCH_BATCH) {
+        const std::size_t n = std::min(PREFETCH_BATCH, count - first);
+        const std::size_t hashedFor = TABLE_SIZE;
+        for (std::size_t i = 0; i < n; i++) {
+            hashed[i] = hashOf(vs[first + i]);
+            prefetchSlot(hashed[i].home);
+        }
+        for (std::size_t i = 0; i < n; i++) {
+            const std::string_view v = vs[first + i];
+            const bool result = resolve(v, TABLE_SIZE == hashedFor ? hashed[i] : hashOf(v));
+            numTrue += result ? 1 : 0;
+            if (results != nullptr)
+                results[first + i] = result;
+        }
+    }
+    return numTrue;
+}
+
+void HashTableDictionary::prefetchSlot(std::size_t idx) const {
+    // The control byte decides the probe; the key cell is read on a
+    // fingerprint match and written by an insert.
+#if defined(__GNUC__)
+    __builtin_prefetch(&controls[idx]);
+    __builtin_prefetch(&keys[idx]);
+    if (probeType == ROBIN_HOOD)
+        __builtin_prefetch(&probeDistances[idx]);
+#else
+    (void)idx;
+#endif
 }
 
 bool HashTableDictionary::empty() const {
-    return numberOfActive == 0;
+    return stats.numberOfActive == 0;
 }
 
 std::string HashTableDictionary::csvStatsHeader() {
@@ -241,107 +910,448 @@ std::string HashTableDictionary::csvStatsHeader() {
                    std::string(",tombstones") +
            std::string(",total_probes") +
            std::string(",inserts") + std::string(",deletes") + std::string(",lookups") +
+           std::string(",lookup_hits") + std::string(",lookup_misses") +
            std::string(",full_scans") + std::string(",compactions") + std::string(",max_in_table") +
+           std::string(",growths") + std::string(",growth_rehashed") + std::string(",table_bytes") +
            std::string(",available_pct") + std::string(",load_factor_pct") +
            std::string(",eff_load_factor_pct") +
-           std::string(",tombstones_pct") + std::string(",average_probes") +
-           std::string(",probe_type") + std::string(",compaction_state");
+           std::string(",tombstones_pct") + std::string(",average_probes") + std::string(",probe_variance") +
+           std::string(",probe_type") + std::string(",hash_function") + std::string(",group_scan") +
+           std::string(",compaction_state");
 }
 
 std::string HashTableDictionary::csvStats() {
-    return std::to_string(TABLE_SIZE) + "," + // table size
-           std::to_string(numberOfActive) + "," + // active
-           std::to_string(TABLE_SIZE - numberOfTombstones - numberOfActive) + "," + // available
-           std::to_string(numberOfTombstones) + "," + // tombstones
-           std::to_string(totalProbes) + "," + // totalProbes
-           std::to_string(numInserts) + "," + // inserts
-           std::to_string(numDeletes) + "," + // deletes
-           std::to_string(numLookups) + "," + // lookups
-           std::to_string(numFullScans) + "," + // full scans
-           std::to_string(numCompactions) + "," + // compactions
-           std::to_string(maxValuesInTable) + "," + // max_in_table
+    return csvStats(stats, TABLE_SIZE, memoryBytes());
+}
+
+std::string HashTableDictionary::csvStats(const Counters& c, std::size_t tableSize, std::size_t bytes) const {
+    return std::to_string(tableSize) + "," + // table size
+           std::to_string(c.numberOfActive) + "," + // active
+           std::to_string(tableSize - c.numberOfTombstones - c.numberOfActive) + "," + // available
+           std::to_string(c.numberOfTombstones) + "," + // tombstones
+           std::to_string(c.totalProbes) + "," + // totalProbes
+           std::to_string(c.numInserts) + "," + // inserts
+           std::to_string(c.numDeletes) + "," + // deletes
+           std::to_string(c.numLookups) + "," + // lookups
+           std::to_string(c.numHits) + "," + // lookups that found the key
+           std::to_string(c.numMisses) + "," + // lookups that did not
+           std::to_string(c.numFullScans) + "," + // full scans
+           std::to_string(c.numCompactions) + "," + // compactions
+           std::to_string(c.maxValuesInTable) + "," + // max_in_table
+           std::to_string(c.numGrowths) + "," + // growths
+           std::to_string(c.numGrowthRehashed) + "," + // keys moved by growth
+           std::to_string(bytes) + "," + // table_bytes
            std::to_string(
-               static_cast<int>(static_cast<double>(TABLE_SIZE - numberOfTombstones - numberOfActive) /
-                   static_cast<double>(TABLE_SIZE) * 100)) + "," + // ratio available
-           std::to_string(static_cast<int>(static_cast<double>(numberOfActive) / static_cast<double>(TABLE_SIZE) * 100))
+               static_cast<int>(static_cast<double>(tableSize - c.numberOfTombstones - c.numberOfActive) /
+                   static_cast<double>(tableSize) * 100)) + "," + // ratio available
+           std::to_string(static_cast<int>(static_cast<double>(c.numberOfActive) / static_cast<double>(tableSize) * 100))
            + "," + // load factor
            std::to_string(
-               static_cast<int>(static_cast<double>(numberOfActive + numberOfTombstones) / static_cast<double>(
-                                    TABLE_SIZE) * 100)) + "," + // effective load factor
+               static_cast<int>(static_cast<double>(c.numberOfActive + c.numberOfTombstones) / static_cast<double>(
+                                    tableSize) * 100)) + "," + // effective load factor
            std::to_string(
-               static_cast<int>(static_cast<double>(numberOfTombstones) / static_cast<double>(TABLE_SIZE) * 100)) + ","
+               static_cast<int>(static_cast<double>(c.numberOfTombstones) / static_cast<double>(tableSize) * 100)) + ","
            + // ratio tombstones
-           std::to_string(static_cast<double>(totalProbes) / static_cast<double>(numInserts + numDeletes + numLookups)) +
-           ((probeType == SINGLE) ? ",single," : ",double,") +
-           (shouldCompact ? "compaction_on" : "compaction_off");
+           std::to_string(static_cast<double>(c.totalProbes) / static_cast<double>(c.numInserts + c.numDeletes + c.numLookups)) +
+           "," + std::to_string(probeVariance(c)) +
+           "," + probeTypeName(probeType) + "," + hashFunctionName(hashFunction) + "," +
+           groupScanName(probeType == SINGLE || probeType == SINGLE_BACKSHIFT ? groupScan : SCALAR) + "," +
+           (!shouldCompact ? "compaction_off" : compactionMode == INCREMENTAL ? "compaction_incremental" : "compaction_on");
+}
+
+HashTableDictionary::Counters& HashTableDictionary::Counters::operator+=(const Counters& other) {
+    numLookups += other.numLookups;
+    numDeletes += other.numDeletes;
+    numInserts += other.numInserts;
+    numCompactions += other.numCompactions;
+    numGrowths += other.numGrowths;
+    numGrowthRehashed += other.numGrowthRehashed;
+    numHits += other.numHits;
+    numMisses += other.numMisses;
+    numFullScans += other.numFullScans;
+    totalProbes += other.totalProbes;
+    totalProbesSquared += other.totalProbesSquared;
+    numProbeSequences += other.numProbeSequences;
+    numberOfActive += other.numberOfActive;
+    numberOfTombstones += other.numberOfTombstones;
+    // The tables peaked at different times, so these are upper bounds.
+    maxTombstones += other.maxTombstones;
+    maxValuesInTable += other.maxValuesInTable;
+    for (std::size_t i = 0; i < PROBE_LENGTH_BUCKETS; i++) {
+        insertProbeLengths[i] += other.insertProbeLengths[i];
+        deleteProbeLengths[i] += other.deleteProbeLengths[i];
+        lookupProbeLengths[i] += other.lookupProbeLengths[i];
+    }
+    return *this;
+}
+
+std::size_t HashTableDictionary::lengthBucket(std::uint64_t length) {
+    if (length < 16)
+        return length == 0 ? 0 : static_cast<std::size_t>(length - 1);
+    const auto msb = static_cast<std::size_t>(63 - __builtin_clzll(length));
+    return std::min(PROBE_LENGTH_BUCKETS - 1, 15 + (msb - 4));
+}
+
+std::uint64_t HashTableDictionary::lengthBucketLow(std::size_t bucket) {
+    return bucket < 15 ? bucket + 1 : 1ull << (bucket - 11);
+}
+
+std::uint64_t HashTableDictionary::lengthBucketHigh(std::size_t bucket) {
+    if (bucket < 15)
+        return bucket + 1;
+    return bucket == PROBE_LENGTH_BUCKETS - 1 ? UINT64_MAX : (1ull << (bucket - 10)) - 1;
+}
+
+double HashTableDictionary::ClusterStats::meanRun() const {
+    return numRuns == 0 ? 0.0 : static_cast<double>(occupiedSlots) / static_cast<double>(numRuns);
+}
+
+template<typename IsOccupied>
+HashTableDictionary::ClusterStats HashTableDictionary::runsOf(std::size_t numSlots, IsOccupied isOccupied) {
+    ClusterStats clusters;
+    auto addRun = [&clusters](std::int64_t length) {
+        clusters.numRuns++;
+        clusters.maxRun = std::max(clusters.maxRun, length);
+        clusters.runLengths[lengthBucket(static_cast<std::uint64_t>(length))]++;
+    };
+    // The run at the start of the table is held back: if the table ends in
+    // a run too, the two are one cluster.
+    std::int64_t firstRun = -1, run = 0;
+    for (std::size_t i = 0; i < numSlots; i++) {
+        if (isOccupied(i)) {
+            run++;
+            clusters.occupiedSlots++;
+        } else if (firstRun < 0) {
+            firstRun = run;
+            run = 0;
+        } else if (run > 0) {
+            addRun(run);
+            run = 0;
+        }
+    }
+    if (firstRun < 0)       // no free slot at all
+        firstRun = 0;
+    if (firstRun + run > 0)
+        addRun(firstRun + run);
+    return clusters;
+}
+
+HashTableDictionary::ClusterStats HashTableDictionary::clusterStats() const {
+    return runsOf(controls.size(), [this](std::size_t i) { return controls[i] != AVAILABLE_CONTROL; });
+}
+
+namespace {
+
+std::string lengthHistogramJson(const HashTableDictionary::LengthHistogram& histogram) {
+    std::string json = "[";
+    for (std::size_t i = 0; i < histogram.size(); i++) {
+        if (histogram[i] == 0)
+            continue;
+        if (json.size() > 1)
+            json += ",";
+        json += "{\"from\":" + std::to_string(HashTableDictionary::lengthBucketLow(i)) +
+                ",\"to\":" + std::to_string(HashTableDictionary::lengthBucketHigh(i)) +
+                ",\"count\":" + std::to_string(histogram[i]) + "}";
+    }
+    return json + "]";
+}
+
+std::string clusterStatsJson(const HashTableDictionary::ClusterStats& clusters) {
+    return "{\"runs\":" + std::to_string(clusters.numRuns) +
+           ",\"max_run\":" + std::to_string(clusters.maxRun) +
+           ",\"mean_run\":" + std::to_string(clusters.meanRun()) +
+           ",\"occupied\":" + std::to_string(clusters.occupiedSlots) +
+           ",\"run_lengths\":" + lengthHistogramJson(clusters.runLengths) + "}";
+}
+
+void appendLengthHistogramCsv(std::string& csv, const std::string& name,
+                              const HashTableDictionary::LengthHistogram& histogram) {
+    for (std::size_t i = 0; i < histogram.size(); i++)
+        if (histogram[i] != 0)
+            csv += name + "," + std::to_string(HashTableDictionary::lengthBucketLow(i)) + "," +
+                   std::to_string(HashTableDictionary::lengthBucketHigh(i)) + "," +
+                   std::to_string(histogram[i]) + "\n";
+}
+
+}
+
+std::string HashTableDictionary::structureStatsJson() const {
+    std::string json = "{\"table_size\":" + std::to_string(TABLE_SIZE) +
+                       ",\"probe_lengths\":{\"insert\":" + lengthHistogramJson(stats.insertProbeLengths) +
+                       ",\"erase\":" + lengthHistogramJson(stats.deleteProbeLengths) +
+                       ",\"lookup\":" + lengthHistogramJson(stats.lookupProbeLengths) + "}" +
+                       ",\"clusters\":" + clusterStatsJson(clusterStats());
+    if (!beforeCompaction.empty() && !afterCompaction.empty()) {
+        json += ",\"clusters_before_compaction\":" + clusterStatsJson(
+            runsOf(beforeCompaction.size(), [this](std::size_t i) { return beforeCompaction[i] == '1'; }));
+        json += ",\"clusters_after_compaction\":" + clusterStatsJson(
+            runsOf(afterCompaction.size(), [this](std::size_t i) { return afterCompaction[i] == '1'; }));
+    }
+    return json + "}";
+}
+
+std::string HashTableDictionary::structureStatsCsv() const {
+    std::string csv;
+    appendLengthHistogramCsv(csv, "insert_probes", stats.insertProbeLengths);
+    appendLengthHistogramCsv(csv, "erase_probes", stats.deleteProbeLengths);
+    appendLengthHistogramCsv(csv, "lookup_probes", stats.lookupProbeLengths);
+    appendLengthHistogramCsv(csv, "cluster_runs", clusterStats().runLengths);
+    return csv;
+}
+
+double HashTableDictionary::probeVariance(const Counters& c) {
+    if (c.numProbeSequences == 0)
+        return 0.0;
+    const double n = static_cast<double>(c.numProbeSequences);
+    const double mean = static_cast<double>(c.totalProbes) / n;
+    return static_cast<double>(c.totalProbesSquared) / n - mean * mean;
+}
+
+std::string HashTableDictionary::probeTypeName(PROBE_TYPE type) {
+    switch (type) {
+        case SINGLE:
+            return "single";
+        case DOUBLE:
+            return "double";
+        case SINGLE_BACKSHIFT:
+            return "single_backshift";
+        case ROBIN_HOOD:
+            return "robin_hood";
+    }
+    return "unknown";
 }
 
 void HashTableDictionary::printStats() const {
 
     const int width = 8;
     std::cout << std::setw(width) << TABLE_SIZE << " table size: " << std::endl;
-    std::cout << std::setw(width) << numberOfTombstones << " cells marked as deleted."  << std::endl;
-    std::cout << std::setw(width) << numberOfActive << " active cells."  << std::endl;
-    std::cout << std::setw(width) << TABLE_SIZE - numberOfTombstones - numberOfActive << " available elements.\n";
-    std::cout << std::setw(width) << maxValuesInTable << " maximum number of values in the table ever." << std::endl;
-    std::cout << std::setw(width) << totalProbes << " total probes." << std::endl;
+    std::cout << std::setw(width) << stats.numberOfTombstones << " cells marked as deleted."  << std::endl;
+    std::cout << std::setw(width) << stats.numberOfActive << " active cells."  << std::endl;
+    std::cout << std::setw(width) << TABLE_SIZE - stats.numberOfTombstones - stats.numberOfActive << " available elements.\n";
+    std::cout << std::setw(width) << stats.maxValuesInTable << " maximum number of values in the table ever." << std::endl;
+    std::cout << std::setw(width) << stats.totalProbes << " total probes." << std::endl;
 
     std::cout << std::endl;
-    std::cout << std::setw(width) << numInserts << " inserts."  << std::endl;
-    std::cout << std::setw(width) << numDeletes << " deletes."  << std::endl;
-    std::cout << std::setw(width) << numLookups << " lookups."  << std::endl;
-    std::cout << std::setw(width) << numFullScans << " full scans."  << std::endl;
-    std::cout << std::setw(width) << numCompactions << " compactions."  << std::endl;
+    std::cout << std::setw(width) << stats.numInserts << " inserts."  << std::endl;
+    std::cout << std::setw(width) << stats.numDeletes << " deletes."  << std::endl;
+    std::cout << std::setw(width) << stats.numLookups << " lookups (" << stats.numHits << " hits, "
+              << stats.numMisses << " misses)."  << std::endl;
+    std::cout << std::setw(width) << stats.numFullScans << " full scans."  << std::endl;
+    std::cout << std::setw(width) << stats.numCompactions << " compactions."  << std::endl;
+    std::cout << std::setw(width) << stats.numGrowths << " growths (" << stats.numGrowthRehashed << " keys moved)." << std::endl;
     std::cout << std::endl;
-    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(TABLE_SIZE - numberOfTombstones - numberOfActive) / static_cast<double>(TABLE_SIZE) * 100) <<
+    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(TABLE_SIZE - stats.numberOfTombstones - stats.numberOfActive) / static_cast<double>(TABLE_SIZE) * 100) <<
         "% ratio of available elements." << std::endl;
 
 
-    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(numberOfActive) / static_cast<double>(TABLE_SIZE) * 100) <<
+    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(stats.numberOfActive) / static_cast<double>(TABLE_SIZE) * 100) <<
         "% load factor." << std::endl;
 
-    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(numberOfActive + numberOfTombstones) / static_cast<double>(TABLE_SIZE) * 100) <<
+    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(stats.numberOfActive + stats.numberOfTombstones) / static_cast<double>(TABLE_SIZE) * 100) <<
         "% effective load factor." << std::endl;
 
 
-    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(numberOfTombstones) / static_cast<double>(TABLE_SIZE) * 100) << "% tombstone fraction." <<  std::endl;
+    std::cout << std::setw(width) << static_cast<int>(static_cast<double>(stats.numberOfTombstones) / static_cast<double>(TABLE_SIZE) * 100) << "% tombstone fraction." <<  std::endl;
 
     std::cout << std::endl;
 
-    std::cout << static_cast<double>(totalProbes) / static_cast<double>(numInserts + numDeletes + numLookups) <<
+    std::cout << static_cast<double>(stats.totalProbes) / static_cast<double>(stats.numInserts + stats.numDeletes + stats.numLookups) <<
      " average number of probes";
 
-    if (probeType == SINGLE)
-        std::cout << " (single probing, " << (shouldCompact ? "compaction on)." : "compaction off).") << std::endl;
-    else
-        std::cout << " (double probing, " << (shouldCompact ? "compaction on)." : "compaction off).") << std::endl;
+    const char *compactionState = !shouldCompact ? "compaction off)." :
+                                  compactionMode == INCREMENTAL ? "incremental compaction)." : "compaction on).";
+    std::cout << " (" << probeTypeName(probeType) << " probing, " << hashFunctionName(hashFunction) << " hash, "
+              << compactionState << std::endl;
+    std::cout << probeVariance(stats) << " variance of the probe-sequence length." << std::endl;
 
 
 }
 
 
-std::size_t HashTableDictionary::primaryHashFunction(const std::string& v) {
+namespace {
+
+// wyhash-style 64-bit hash: folds the key 16 bytes at a time through a
+// 64x64->128-bit multiply, so a two-word trace key costs a couple of
+// multiplies instead of one integer division per character.
+std::uint64_t mum(std::uint64_t a, std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    const __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+#else
+    const std::uint64_t lo = a * b;
+    const std::uint64_t hi = (a >> 32) * (b >> 32) + (((a >> 32) * (b & 0xffffffff)) >> 32) +
+                             (((a & 0xffffffff) * (b >> 32)) >> 32);
+    return lo ^ hi;
+#endif
+}
+
+std::uint64_t read8(const unsigned char *p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::uint64_t read4(const unsigned char *p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// The bytes wyhash64 reads, by offset from the start of the key.
+struct ContiguousBytes {
+    const unsigned char *p;
+    std::size_t length;
+
+    explicit ContiguousBytes(std::string_view v)
+        : p(reinterpret_cast<const unsigned char *>(v.data())), length(v.size()) {}
+    [[nodiscard]] std::size_t size() const { return length; }
+    [[nodiscard]] std::uint64_t byte(std::size_t i) const { return p[i]; }
+    [[nodiscard]] std::uint64_t word4(std::size_t i) const { return read4(p + i); }
+    [[nodiscard]] std::uint64_t word8(std::size_t i) const { return read8(p + i); }
+};
+
+// The same for a JoinedKey. A word that lies within one of the two pieces
+// is read directly; only the word or two that span the separator are
+// gathered a byte at a time.
+struct JoinedBytes {
+    const JoinedKey& key;
+
+    explicit JoinedBytes(const JoinedKey& k) : key(k) {}
+    [[nodiscard]] std::size_t size() const { return key.size(); }
+    [[nodiscard]] std::uint64_t byte(std::size_t i) const { return static_cast<unsigned char>(key[i]); }
+    [[nodiscard]] std::uint64_t word4(std::size_t i) const { return word<4>(i); }
+    [[nodiscard]] std::uint64_t word8(std::size_t i) const { return word<8>(i); }
+
+    template<std::size_t WIDTH>
+    [[nodiscard]] std::uint64_t word(std::size_t i) const {
+        const std::size_t split = key.first.size();
+        unsigned char bytes[WIDTH];
+        if (i + WIDTH <= split) {
+            std::memcpy(bytes, key.first.data() + i, WIDTH);
+        } else if (i > split) {
+            std::memcpy(bytes, key.second.data() + (i - split - 1), WIDTH);
+        } else {
+            for (std::size_t j = 0; j < WIDTH; j++)
+                bytes[j] = static_cast<unsigned char>(key[i + j]);
+        }
+        return WIDTH == 8 ? read8(bytes) : read4(bytes);
+    }
+};
+
+template<typename Bytes>
+std::uint64_t wyhash64(const Bytes& key) {
+    const std::uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL, s2 = 0x8ebc6af09c88c6e3ULL;
+    const std::size_t len = key.size();
+    std::uint64_t seed = s0 ^ mum(len ^ s0, s1);
+    std::uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (key.word4(0) << 32) | key.word4((len >> 3) << 2);
+            b = (key.word4(len - 4) << 32) | key.word4(len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = (key.byte(0) << 16) | (key.byte(len >> 1) << 8) | key.byte(len - 1);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        std::size_t i = len, at = 0;
+        for (; i > 16; i -= 16, at += 16)
+            seed = mum(key.word8(at) ^ s1, key.word8(at + 8) ^ seed);
+        a = key.word8(at + i - 16);
+        b = key.word8(at + i - 8);
+    }
+    return mum(s1 ^ len, mum(a ^ s1, b ^ seed) ^ s2);
+}
+
+ContiguousBytes bytesOf(std::string_view v) {
+    return ContiguousBytes(v);
+}
+
+JoinedBytes bytesOf(const JoinedKey& key) {
+    return JoinedBytes(key);
+}
+
+// Maps a 64-bit value onto [0, n) with a multiply and a shift (Lemire's
+// "fastrange") instead of a division.
+std::size_t fastRange(std::uint64_t h, std::size_t n) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<std::size_t>((static_cast<__uint128_t>(h) * n) >> 64);
+#else
+    return static_cast<std::size_t>(h % n);
+#endif
+}
+
+}
+
+HashTableDictionary::HashedKey HashTableDictionary::hashKey(std::string_view v) const {
+    return hashOf(v);
+}
+
+HashTableDictionary::HashedKey HashTableDictionary::hashKey(const JoinedKey& key) const {
+    return hashOf(key);
+}
+
+template<typename Key>
+HashTableDictionary::HashedKey HashTableDictionary::hashOf(const Key& v) const {
+    if (hashFunction == MODULAR)
+        return {primaryHashFunction(v), secondaryHashFunction(v), fingerprintFunction(v)};
+
+    // One pass over the key, split into disjoint bits so that the three are
+    // independent: the home slot comes from bits 32-63, the double-hashing
+    // step from bits 7-31 and the fingerprint from bits 0-6.
+    const std::uint64_t h = wyhash64(bytesOf(v));
+    const std::size_t step = probeType == DOUBLE ? 1 + fastRange(h >> 7 << 39, TABLE_SIZE - 1) : 1;
+    return {fastRange(h >> 32 << 32, TABLE_SIZE), step, static_cast<std::uint8_t>(h & 0x7F)};
+}
+
+std::uint64_t HashTableDictionary::hash64(std::string_view v) {
+    return wyhash64(bytesOf(v));
+}
+
+std::uint64_t HashTableDictionary::hash64(const JoinedKey& key) {
+    return wyhash64(bytesOf(key));
+}
+
+std::string HashTableDictionary::hashFunctionName(HASH_FUNCTION function) {
+    return function == MODULAR ? "modular" : "wyhash";
+}
+
+template<typename Key>
+std::size_t HashTableDictionary::primaryHashFunction(const Key& v) const {
 
     std::size_t idx = 0;
-    for (unsigned char c : v) {
+    forEachByte(v, [&idx, this](unsigned char c) {
         idx = (idx * 131 + c) % TABLE_SIZE;     // base 131
-    }
+    });
     return idx;                                 // 0..LARGE_TWIN-1
 }
 
 
-std::size_t HashTableDictionary::secondaryHashFunction(const std::string& v) {
-    if (probeType == SINGLE)
+template<typename Key>
+std::size_t HashTableDictionary::secondaryHashFunction(const Key& v) const {
+    if (probeType != DOUBLE)
         return 1;                // linear probing
 
 
     std::size_t idx = 0;
-    for (unsigned char c : v) {
+    forEachByte(v, [&idx, this](unsigned char c) {
         idx = (idx * 257 + c) % (TABLE_SIZE - 1);      // base 257
-    }
+    });
     return 1 + idx;                                    // 1..LARGE_TWIN-1  (gcd(step, LARGE_TWIN)=1)
 }
 
+template<typename Key>
+std::uint8_t HashTableDictionary::fingerprintFunction(const Key& v) {
+    // FNV-1a over the key; the top bits are the best-mixed ones.
+    std::uint64_t h = 14695981039346656037ULL;
+    forEachByte(v, [&h](unsigned char c) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    });
+    return static_cast<std::uint8_t>(h >> 57);
+}
+
 void inRed(char c) {
     std::cout << "\x1b[31m" << c << "\x1b[0m";
 }
@@ -367,14 +1377,14 @@ void inCyan(char c) {
 
 void HashTableDictionary::printMask(ELEMENT_STATUS es) {
     for(size_t i = 0; i < TABLE_SIZE; i++) {
-        if(hashTableMask.at(i) == USED)
+        if(statusAt(i) == USED)
             inRed(es == USED ? '-' : ' ');
-        else if (hashTableMask.at(i) == AVAILABLE)
+        else if (statusAt(i) == AVAILABLE)
             inYellow(es == AVAILABLE ? '-' : ' ');
-        else if( hashTableMask.at(i) == DELETED)
+        else if( statusAt(i) == DELETED)
             inGreen(es == DELETED ? '-' : ' ');
         else {
-            std::cout << "\nUnrecognize element type with value: " << hashTableMask.at(i) << "." << std::endl;
+            std::cout << "\nUnrecognize element type with value: " << static_cast<int>(controls.at(i)) << "." << std::endl;
             exit(1);
         }
         if(  (i + 1) % 100 == 0)
@@ -5,24 +5,154 @@
 #ifndef HASHTABLESOPENADDRESSING_HASHTABLEDICTIONARY_HPP
 #define HASHTABLESOPENADDRESSING_HASHTABLEDICTIONARY_HPP
 
+#include<array>
 #include<vector>
 #include<string>
+#include<string_view>
+#include<cstdint>
+#include<algorithm>
+#include "KeyArena.hpp"
+#include "SlotArray.hpp"
 
 class HashTableDictionary {
 
     enum ELEMENT_STATUS {AVAILABLE, DELETED, USED};
+    enum MIGRATION_PHASE {IDLE, MIGRATING, SCRUBBING};
 
 public:
-    enum PROBE_TYPE {SINGLE, DOUBLE};
+    // SINGLE_BACKSHIFT is linear probing whose remove() shifts the rest of the
+    // cluster back into the hole instead of leaving a DELETED tombstone.
+    // ROBIN_HOOD is linear probing where an insert takes the slot of any entry
+    // that is closer to its home slot, so lookups can stop early; it deletes
+    // by backward shift as well.
+    enum PROBE_TYPE {SINGLE, DOUBLE, SINGLE_BACKSHIFT, ROBIN_HOOD};
+    // STOP_THE_WORLD rebuilds the whole table inside the insert that crosses the
+    // trigger. INCREMENTAL drains the old slots a few at a time on every
+    // subsequent insert/remove, keeping a spare set of slot arrays around.
+    enum COMPACTION_MODE {STOP_THE_WORLD, INCREMENTAL};
+    // MODULAR is the original pair of per-character base-131/base-257 hashes.
+    // WYHASH hashes the key once into 64 bits and derives the home slot, the
+    // double-hashing step and the fingerprint from that value.
+    enum HASH_FUNCTION {MODULAR, WYHASH};
+    // How SINGLE and SINGLE_BACKSHIFT probes walk the control bytes. SCALAR
+    // tests one slot per iteration; SSE2 and AVX2 compare a group of 16 or 32
+    // control bytes against the fingerprint and the empty/deleted markers at
+    // once. All three give the same slots and probe counts.
+    enum GROUP_SCAN {SCALAR, SSE2, AVX2};
+
+    // Everything a probe sequence needs, computed once per operation.
+    // fingerprint is the 7-bit fragment stored in a USED slot's control byte.
+    struct HashedKey {
+        std::size_t home;
+        std::size_t step;
+        std::uint8_t fingerprint;
+    };
+
+    // Counts of lengths (probe sequences, clusters) in PROBE_LENGTH_BUCKETS
+    // buckets: one per length from 1 to 15, then one per power of two (16-31,
+    // 32-63, ...), the last one also counting everything longer.
+    static constexpr std::size_t PROBE_LENGTH_BUCKETS = 40;
+    using LengthHistogram = std::array<std::int64_t, PROBE_LENGTH_BUCKETS>;
+    static std::size_t lengthBucket( std::uint64_t length );
+    // The shortest and longest length counted in bucket.
+    static std::uint64_t lengthBucketLow( std::size_t bucket );
+    static std::uint64_t lengthBucketHigh( std::size_t bucket );
+
+    // Operation, probe and occupancy statistics. Tables used together (see
+    // ShardedHashTableDictionary) add theirs up with +=.
+    struct Counters {
+        std::int64_t numLookups = 0;
+        std::int64_t numDeletes = 0;
+        std::int64_t numInserts = 0;
+
+        int numCompactions = 0;
+        int numGrowths = 0;
+        std::int64_t numGrowthRehashed = 0;
+
+        // Lookups that found the key and that did not.
+        std::int64_t numHits = 0;
+        std::int64_t numMisses = 0;
+        std::int64_t numFullScans = 0;
+
+        std::int64_t totalProbes = 0;
+        std::int64_t totalProbesSquared = 0;
+        std::int64_t numProbeSequences = 0;
+
+        std::int64_t numberOfActive = 0;
+        std::int64_t numberOfTombstones = 0;
+        std::int64_t maxTombstones = 0;
+
+        std::int64_t maxValuesInTable = 0;
+
+        // Lengths of the main probe sequence of each insert, remove and member.
+        LengthHistogram insertProbeLengths{};
+        LengthHistogram deleteProbeLengths{};
+        LengthHistogram lookupProbeLengths{};
+
+        Counters& operator+=( const Counters& other );
+    };
+
+    // Runs of consecutive slots that are not AVAILABLE, i.e. live keys and
+    // tombstones, which a probe has to walk over. A run that reaches the end
+    // of the table continues at its start.
+    struct ClusterStats {
+        std::int64_t numRuns = 0;
+        std::int64_t maxRun = 0;
+        std::int64_t occupiedSlots = 0;
+        LengthHistogram runLengths{};
+
+        [[nodiscard]] double meanRun() const;
+    };
 
     HashTableDictionary( std::size_t tableSize_,
-        PROBE_TYPE probeType, bool doCompact=false, double compactionTriggerRate=0.95);
+        PROBE_TYPE probeType, bool doCompact=false, double compactionTriggerRate=0.95,
+        COMPACTION_MODE compactionMode=STOP_THE_WORLD, HASH_FUNCTION hashFunction=MODULAR,
+        const slotmemory::Placement& placement=slotmemory::Placement());
+
+
 
+    bool insert( std::string_view v );
+    bool member( std::string_view v );
+    bool remove( std::string_view v);
 
+    // The key w1 + ' ' + w2, e.g. from the two words of a trace line. It is
+    // hashed and compared a piece at a time and never assembled: only an
+    // insert copies its bytes, straight into the key cell or the arena. It
+    // hashes to the same value as the joined string, and when w2 already
+    // follows w1 and a single space in one buffer (see joinedInPlace()),
+    // that string is used in place.
+    class JoinedKey {
+    public:
+        JoinedKey( std::string_view w1, std::string_view w2 ) : first(w1), second(w2) {}
+        [[nodiscard]] std::size_t size() const { return first.size() + 1 + second.size(); }
+        [[nodiscard]] char operator[]( std::size_t i ) const {
+            return i < first.size() ? first[i] : i == first.size() ? ' ' : second[i - first.size() - 1];
+        }
+        // Writes the size() bytes of the key to out.
+        void copyTo( char *out ) const;
+        bool operator==( std::string_view key ) const;
 
-    bool insert( const std::string& v );
-    bool member( const std::string& v );
-    bool remove( const std::string& v);
+        std::string_view first, second;
+    };
+    bool insert( const JoinedKey& key );
+    bool member( const JoinedKey& key );
+    bool remove( const JoinedKey& key );
+    bool insert( std::string_view w1, std::string_view w2 ) { return insert(JoinedKey(w1, w2)); }
+    bool member( std::string_view w1, std::string_view w2 ) { return member(JoinedKey(w1, w2)); }
+    bool remove( std::string_view w1, std::string_view w2 ) { return remove(JoinedKey(w1, w2)); }
+    // member() without updating any counters. Concurrent calls are safe as
+    // long as nothing modifies the table meanwhile.
+    [[nodiscard]] bool contains( std::string_view v ) const;
+    [[nodiscard]] bool contains( const JoinedKey& key ) const;
+    // The same as calling insert()/remove()/member() on vs[0], ..., vs[count-1]
+    // in order, but each PREFETCH_BATCH keys are hashed and their home slots
+    // prefetched before any of them is probed, so that the cache misses of
+    // a large table overlap. results, if given, receives each call's result;
+    // the return value is the number of calls that returned true.
+    std::size_t insertBatch( const std::string_view* vs, std::size_t count, bool* results=nullptr );
+    std::size_t removeBatch( const std::string_view* vs, std::size_t count, bool* results=nullptr );
+    std::size_t memberBatch( const std::string_view* vs, std::size_t count, bool* results=nullptr );
+    static constexpr std::size_t PREFETCH_BATCH = 32;
     [[nodiscard]] bool empty() const;
     [[nodiscard]] std::size_t size() const;
     void printStats() const;
@@ -34,47 +164,217 @@ public:
     void printActiveDeleteMap();
 
     void clear();
+    // Writes the table to path as a snapshot: a versioned header, then the
+    // slot arrays, the key arena's slabs and the counters, each laid out as
+    // in memory. An incremental compaction in flight is finished first.
+    // The snapshot is written to path + ".tmp" and renamed over path once
+    // complete, so path may be the file this table was loaded from. Returns
+    // false, leaving path as it was, if the file cannot be written.
+    bool save( const std::string& path );
+    // Replaces this table, settings included, with the snapshot at path. The
+    // file is mapped MAP_PRIVATE and used in place: nothing is parsed per
+    // key, pages are read in when first touched, and later changes to the
+    // table never reach the file. The slot arrays stay on the file's pages,
+    // whatever placement() asks for, until a rebuild reallocates them.
+    // Returns false, leaving the table as it was, if the file cannot be
+    // mapped, is truncated, comes from another snapshot version or a build
+    // with a different slot layout, or has settings, counters, arena state
+    // or free-list entries that are out of range. The cells themselves are
+    // trusted unless check is CHECK_CELLS, which also rejects cells whose
+    // keys would lie outside the file or that do not add up to the counters,
+    // at the cost of reading every control byte and key cell up front.
+    enum SNAPSHOT_CHECK {CHECK_LAYOUT, CHECK_CELLS};
+    bool load( const std::string& path, SNAPSHOT_CHECK check = CHECK_LAYOUT );
+    // Prints compaction progress and records the before/after occupancy maps
+    // used by printBeforeAndAfterCompactionMaps(). Off by default so that
+    // compaction does not do O(TABLE_SIZE) bookkeeping or write to stdout.
+    void setVerbose(bool on) { verbose = on; }
+    // Number of old slots handled per insert/remove during incremental compaction.
+    void setMigrationStep(std::size_t slotsPerOp) { migrationStep = std::max<std::size_t>(slotsPerOp, 1); }
+    [[nodiscard]] int compactions() const { return stats.numCompactions; }
+    // True while an incremental compaction is moving or scrubbing old slots,
+    // i.e. while insert()/remove() also do part of its work.
+    [[nodiscard]] bool isMigrating() const { return migrationPhase != IDLE; }
+    [[nodiscard]] const Counters& counters() const { return stats; }
+    // Selects the group scan. Asking for an instruction set this CPU lacks
+    // falls back to the best one it has. Defaults to bestGroupScan().
+    void setGroupScan(GROUP_SCAN scan) { groupScan = std::min(scan, bestGroupScan()); }
+    // Where the slot arrays' memory comes from: huge pages and NUMA nodes
+    // (see slotmemory::Placement). Moves the current arrays, and the arrays
+    // of later rebuilds and compactions are allocated the same way. The key
+    // arena's slabs stay on the heap.
+    void setPlacement(const slotmemory::Placement& placement);
+    [[nodiscard]] const slotmemory::Placement& placement() const { return slotPlacement; }
+    // Bytes held by the slot arrays and the key arena, spare arrays included.
+    [[nodiscard]] std::size_t memoryBytes() const;
+    // Enables automatic growth: once live keys plus tombstones exceed this
+    // fraction of the table, insert() rebuilds the table, at about twice the
+    // size unless tombstones account for most of the load. 0 (the default)
+    // keeps the size fixed, and a full table still terminates the program.
+    void setGrowthLoadFactor(double loadFactor);
+    [[nodiscard]] std::size_t tableSize() const { return TABLE_SIZE; }
+    static std::size_t nextPrime(std::size_t n);
     std::string csvStats();
+    // Formats totals, e.g. summed over several tables, as a csvStats() row
+    // using this table's probe type, hash function and compaction settings.
+    [[nodiscard]] std::string csvStats( const Counters& totals, std::size_t tableSize, std::size_t bytes ) const;
     static std::string csvStatsHeader();
+    // One pass over the control bytes.
+    [[nodiscard]] ClusterStats clusterStats() const;
+    // Probe-length histograms and cluster statistics, the latter also for
+    // the occupancy just before and after the latest compaction when
+    // setVerbose(true) recorded it. structureStatsCsv() has one row per
+    // non-empty bucket, with the columns of structureStatsCsvHeader().
+    [[nodiscard]] std::string structureStatsJson() const;
+    [[nodiscard]] std::string structureStatsCsv() const;
+    static std::string structureStatsCsvHeader() { return "histogram,from,to,count"; }
+    static std::string probeTypeName(PROBE_TYPE type);
+    static std::string hashFunctionName(HASH_FUNCTION function);
+    static GROUP_SCAN bestGroupScan();
+    static std::string groupScanName(GROUP_SCAN scan);
+    [[nodiscard]] HashedKey hashKey( std::string_view v ) const;
+    [[nodiscard]] HashedKey hashKey( const JoinedKey& key ) const;
+    // The 64-bit hash that WYHASH derives its probe sequences from.
+    static std::uint64_t hash64( std::string_view v );
+    static std::uint64_t hash64( const JoinedKey& key );
 
 
 private:
     std::size_t  TABLE_SIZE;
+    std::size_t  initialTableSize;
     PROBE_TYPE probeType;
 
-    std::vector<std::string> hashTable;
-    std::vector<ELEMENT_STATUS> hashTableMask;
+    // One control byte per slot: AVAILABLE_CONTROL or DELETED_CONTROL (high bit
+    // set), or, for a USED slot, the 7-bit fingerprint of its key. A probe reads
+    // only this array until a fingerprint matches, so 64 slots of metadata fit
+    // in one cache line and key bytes are touched only for likely matches.
+    static constexpr std::uint8_t AVAILABLE_CONTROL = 0x80;
+    static constexpr std::uint8_t DELETED_CONTROL = 0xFE;
+    static bool isUsed(std::uint8_t control) { return (control & 0x80) == 0; }
+    // The slot step slots after idx. Both are below TABLE_SIZE, so the wrap
+    // is one compare and subtract instead of a division.
+    [[nodiscard]] std::size_t advance(std::size_t idx, std::size_t step) const {
+        idx += step;
+        return idx >= TABLE_SIZE ? idx - TABLE_SIZE : idx;
+    }
+
+    // A 24-byte key cell. Keys of up to INLINE_CAPACITY bytes are stored in
+    // the cell itself; longer keys live in keyArena and the cell holds their
+    // KeyArena::Handle and length.
+    struct KeySlot {
+        static constexpr std::size_t INLINE_CAPACITY = 23;
+        static constexpr std::uint8_t IN_ARENA = 0xFF;
+        char bytes[INLINE_CAPACITY];
+        std::uint8_t length;    // inline length, or IN_ARENA
+    };
+
+    SlotArray<std::uint8_t> controls;
+    SlotArray<KeySlot> keys;
+    GROUP_SCAN groupScan = bestGroupScan();
+    // Steps each USED slot's key is from its home slot along its probe
+    // sequence. Only meaningful for USED cells, so compaction does not swap it.
+    SlotArray<std::uint32_t> probeDistances;
+    slotmemory::Placement slotPlacement;
+    // Keys too long to be stored inline. Removed keys' bytes are reused by
+    // later inserts of similar length; compactArena() repacks the live ones
+    // into spareArena and swaps the two, so repacking reuses the same slabs.
+    KeyArena keyArena;
+    KeyArena spareArena;
 
     std::vector<char> beforeCompaction, afterCompaction;
 
-    std::size_t primaryHashFunction( const std::string&  v );
-    std::size_t secondaryHashFunction( const std::string&  v );
-    std::size_t memberHelper( const std::string& v );
+    // The functions below that take a Key are defined and used only in
+    // HashTableDictionary.cpp, for std::string_view and JoinedKey keys.
+    template<typename Key>
+    [[nodiscard]] HashedKey hashOf( const Key& v ) const;
+    template<typename Key>
+    std::size_t primaryHashFunction( const Key& v ) const;
+    template<typename Key>
+    std::size_t secondaryHashFunction( const Key& v ) const;
+    template<typename Key>
+    static std::uint8_t fingerprintFunction( const Key& v );
+    [[nodiscard]] ELEMENT_STATUS statusAt( std::size_t idx ) const;
+    [[nodiscard]] std::string_view keyAt( const KeySlot& slot ) const;
+    template<typename Key>
+    [[nodiscard]] bool slotHolds( std::size_t idx, const Key& v, std::uint8_t fp ) const;
+    template<typename Key>
+    KeySlot storeKey( const Key& v );
+    void releaseKey( const KeySlot& slot );
+    void compactArena();
+    template<typename Key>
+    std::size_t memberHelper( const Key& v, const HashedKey& hk, std::uint32_t& distance,
+                              LengthHistogram& probeLengths );
+    // The bodies of insert()/remove()/member() once v is hashed. hk must be
+    // for the current TABLE_SIZE, so insert() calls makeRoomForInsert(),
+    // which may grow the table, before hashing.
+    void makeRoomForInsert();
+    template<typename Key>
+    bool insertKey( const Key& v );
+    template<typename Key>
+    bool insertHashed( const Key& v, const HashedKey& hk );
+    template<typename Key>
+    bool removeHashed( const Key& v, const HashedKey& hk );
+    template<typename Key>
+    bool memberHashed( const Key& v, const HashedKey& hk );
+    template<typename Key>
+    [[nodiscard]] bool containsKey( const Key& v ) const;
+    void prefetchSlot( std::size_t idx ) const;
+    template<typename Resolve>
+    std::size_t resolveBatch( const std::string_view* vs, std::size_t count, bool* results, Resolve resolve );
+    template<typename Key>
+    std::size_t findSlot( const Key& v, const HashedKey& hk, std::uint32_t& distance,
+                          std::int64_t& numProbes ) const;
+
+    // Bit i of each mask describes control byte idx + i.
+    struct GroupMasks {
+        std::uint32_t match;        // equals the fingerprint
+        std::uint32_t available;
+        std::uint32_t deleted;
+    };
+    [[nodiscard]] GroupMasks groupMasks( std::size_t idx, std::size_t width, std::uint8_t fp ) const;
+    template<typename Key>
+    std::size_t groupScanFrom( const Key& v, std::uint8_t fp, std::size_t idx, std::int64_t& numProbes,
+                               std::size_t& firstDeleteIdx, std::uint32_t& firstDeleteDistance ) const;
+    void backwardShiftFrom( std::size_t hole );
+    void robinHoodPlace( std::size_t idx, KeySlot slot, std::uint8_t fp, std::uint32_t distance );
     [[nodiscard]] double effectiveLoadFactor() const;
+    [[nodiscard]] static double probeVariance( const Counters& c );
 
     void compactTable();
+    void growOrCompact();
+    void rehashInto( std::size_t newSize );
+    void placeRehashed( const KeySlot& slot );
+    void recordOccupancy( std::vector<char>& map ) const;
+    template<typename IsOccupied>
+    static ClusterStats runsOf( std::size_t numSlots, IsOccupied isOccupied );
+
+    void beginIncrementalCompaction();
+    void advanceCompaction( std::size_t budget );
+    template<typename Key>
+    std::size_t drainingSlotOf( const Key& v, const HashedKey& hk );
+    template<typename Key>
+    std::size_t findDrainingSlot( const Key& v, const HashedKey& hk, std::int64_t& numProbes ) const;
 
     double compactionTriggerEffectiveRate = 0.95;
 
     bool shouldCompact = false;
+    COMPACTION_MODE compactionMode = STOP_THE_WORLD;
+    HASH_FUNCTION hashFunction = MODULAR;
+    bool verbose = false;
+    double growthLoadFactor = 0.0;
 
-    std::int64_t numLookups = 0;
-    std::int64_t numDeletes = 0;
-    std::int64_t numInserts = 0;
-
-    int numCompactions = 0;
-
-    std::int64_t numHits = 0;
-    std::int64_t numMisses = 0;
-    std::int64_t numFullScans = 0;
-
-    std::int64_t totalProbes = 0;
-
-    std::int64_t numberOfActive = 0;
-    std::int64_t numberOfTombstones = 0;
-    std::int64_t maxTombstones = 0;
+    // Incremental compaction state. While MIGRATING, live keys are spread over
+    // the current arrays and old*, and old* is kept probe-able by turning every
+    // migrated slot into a DELETED cell. SCRUBBING then resets old* to AVAILABLE
+    // so that the next compaction can start with a swap.
+    MIGRATION_PHASE migrationPhase = IDLE;
+    SlotArray<std::uint8_t> oldControls;
+    SlotArray<KeySlot> oldKeys;
+    std::size_t migrationCursor = 0;
+    std::size_t migrationStep = 64;
+    std::int64_t drainingActive = 0;
 
-    std::int64_t maxValuesInTable = 0;
+    Counters stats;
 };
 
 
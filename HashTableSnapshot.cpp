@@ -0,0 +1,313 @@
+// HashTableSnapshot.cpp
+// HashTableDictionary::save() and load(). A snapshot is a SnapshotHeader
+// followed by sections at SECTION_ALIGNMENT-byte offsets: the control
+// bytes, the key cells, the probe distances, the counters, a table of
+// (offset, capacity) pairs for the key arena's slabs, the slabs' bytes, and
+// the arena's free lists (a count per size class, then the handles). All
+// of it is in the layout and byte order of the build that wrote it, so
+// load() can point the table's arrays into the mapped file.
+
+#include "HashTableDictionary.hpp"
+
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<type_traits>
+
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'H', 'T', 'S', 'N', 'A', 'P', 'S', 'H'};
+// Bumped whenever the layout below or the meaning of a section changes.
+constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+// A cache line, which is also enough for every section's items.
+constexpr std::uint64_t SECTION_ALIGNMENT = 64;
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    // Sizes that tell snapshots of builds with a different layout apart.
+    std::uint32_t headerBytes;
+    std::uint32_t keySlotBytes;
+    std::uint32_t countersBytes;
+
+    std::uint64_t tableSize;
+    std::uint64_t initialTableSize;
+    std::uint32_t probeType;
+    std::uint32_t compactionMode;
+    std::uint32_t hashFunction;
+    std::uint32_t shouldCompact;
+    double compactionTriggerRate;
+    double growthLoadFactor;
+    std::uint64_t migrationStep;
+
+    std::uint64_t numSlabs;
+    std::uint64_t currentSlab;
+    std::uint64_t slabUsed;
+    std::uint64_t reservedBytes;
+    std::uint64_t deadBytes;
+    std::uint64_t numFreeLists;
+    std::uint64_t numFreeHandles;
+
+    std::uint64_t controlsOffset;
+    std::uint64_t keysOffset;
+    std::uint64_t distancesOffset;
+    std::uint64_t countersOffset;
+    std::uint64_t slabTableOffset;
+    std::uint64_t freeListsOffset;
+    std::uint64_t fileBytes;
+};
+
+struct SlabEntry {
+    std::uint64_t offset;
+    std::uint64_t capacity;
+};
+
+std::uint64_t aligned(std::uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Whether [offset, offset + count * width) lies within fileBytes.
+bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t width, std::uint64_t fileBytes) {
+    return offset <= fileBytes && count <= (fileBytes - offset) / width;
+}
+
+}
+
+bool HashTableDictionary::save(const std::string& path) {
+    static_assert(std::is_trivially_copyable_v<Counters>, "Counters are saved as bytes");
+    if (migrationPhase != IDLE)
+        advanceCompaction(2 * oldControls.size());
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.headerBytes = sizeof(SnapshotHeader);
+    header.keySlotBytes = sizeof(KeySlot);
+    header.countersBytes = sizeof(Counters);
+    header.tableSize = TABLE_SIZE;
+    header.initialTableSize = initialTableSize;
+    header.probeType = probeType;
+    header.compactionMode = compactionMode;
+    header.hashFunction = hashFunction;
+    header.shouldCompact = shouldCompact;
+    header.compactionTriggerRate = compactionTriggerEffectiveRate;
+    header.growthLoadFactor = growthLoadFactor;
+    header.migrationStep = migrationStep;
+
+    header.numSlabs = keyArena.slabs.size();
+    header.currentSlab = keyArena.currentSlab;
+    header.slabUsed = keyArena.slabUsed;
+    header.reservedBytes = keyArena.reserved;
+    header.deadBytes = keyArena.dead;
+    header.numFreeLists = keyArena.freeLists.size();
+    for (const auto& list : keyArena.freeLists)
+        header.numFreeHandles += list.size();
+
+    header.controlsOffset = aligned(sizeof(SnapshotHeader));
+    header.keysOffset = aligned(header.controlsOffset + TABLE_SIZE * sizeof(std::uint8_t));
+    header.distancesOffset = aligned(header.keysOffset + TABLE_SIZE * sizeof(KeySlot));
+    header.countersOffset = aligned(header.distancesOffset + TABLE_SIZE * sizeof(std::uint32_t));
+    header.slabTableOffset = aligned(header.countersOffset + sizeof(Counters));
+    std::vector<SlabEntry> slabTable;
+    std::uint64_t end = header.slabTableOffset + header.numSlabs * sizeof(SlabEntry);
+    for (const auto& slab : keyArena.slabs) {
+        slabTable.push_back({aligned(end), slab.capacity});
+        end = slabTable.back().offset + slab.capacity;
+    }
+    header.freeListsOffset = aligned(end);
+    header.fileBytes = header.freeListsOffset + (header.numFreeLists + header.numFreeHandles) * sizeof(std::uint64_t);
+
+    // Truncating path itself would pull the pages from under a table loaded
+    // from it, this one included.
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+    std::uint64_t written = 0;
+    auto put = [&](std::uint64_t offset, const void *bytes, std::uint64_t length) {
+        static const char zeros[SECTION_ALIGNMENT] = {};
+        out.write(zeros, static_cast<std::streamsize>(offset - written));
+        out.write(static_cast<const char *>(bytes), static_cast<std::streamsize>(length));
+        written = offset + length;
+    };
+    put(0, &header, sizeof(header));
+    put(header.controlsOffset, controls.data(), TABLE_SIZE * sizeof(std::uint8_t));
+    put(header.keysOffset, keys.data(), TABLE_SIZE * sizeof(KeySlot));
+    put(header.distancesOffset, probeDistances.data(), TABLE_SIZE * sizeof(std::uint32_t));
+    put(header.countersOffset, &stats, sizeof(Counters));
+    put(header.slabTableOffset, slabTable.data(), slabTable.size() * sizeof(SlabEntry));
+    for (std::size_t i = 0; i < slabTable.size(); i++)
+        put(slabTable[i].offset, keyArena.slabs[i].bytes, slabTable[i].capacity);
+    put(header.freeListsOffset, nullptr, 0);
+    for (const auto& list : keyArena.freeLists) {
+        const std::uint64_t count = list.size();
+        put(written, &count, sizeof(count));
+    }
+    for (const auto& list : keyArena.freeLists)
+        put(written, list.data(), list.size() * sizeof(KeyArena::Handle));
+    out.close();
+    bool complete = static_cast<bool>(out) && written == header.fileBytes;
+    if (complete) {
+        const int fd = ::open(tmpPath.c_str(), O_RDONLY);
+        complete = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0)
+            close(fd);
+    }
+    if (!complete || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool HashTableDictionary::load(const std::string& path, SNAPSHOT_CHECK check) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    const std::size_t length = static_cast<std::size_t>(st.st_size);
+    // Private and writable: the table's arrays are modified in place, and
+    // each page is copied the first time that happens.
+    void *addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+    std::shared_ptr<void> mapping(addr, [length](void *p) { munmap(p, length); });
+    char *base = static_cast<char *>(addr);
+
+    SnapshotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    const std::uint64_t n = header.tableSize;
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.version != SNAPSHOT_VERSION || header.headerBytes != sizeof(SnapshotHeader) ||
+        header.keySlotBytes != sizeof(KeySlot) || header.countersBytes != sizeof(Counters) ||
+        header.fileBytes != length || n == 0 || header.probeType > ROBIN_HOOD ||
+        header.compactionMode > INCREMENTAL || header.hashFunction > WYHASH ||
+        header.currentSlab > header.numSlabs || header.initialTableSize == 0 || header.migrationStep == 0 ||
+        !(header.compactionTriggerRate > 0.0 && header.compactionTriggerRate <= 1.0) ||
+        !(header.growthLoadFactor >= 0.0 && header.growthLoadFactor <= 0.99))
+        return false;
+    for (std::uint64_t offset : {header.controlsOffset, header.keysOffset, header.distancesOffset,
+                                 header.countersOffset, header.slabTableOffset, header.freeListsOffset})
+        if (offset % SECTION_ALIGNMENT != 0)
+            return false;
+    if (!fits(header.controlsOffset, n, sizeof(std::uint8_t), length) ||
+        !fits(header.keysOffset, n, sizeof(KeySlot), length) ||
+        !fits(header.distancesOffset, n, sizeof(std::uint32_t), length) ||
+        !fits(header.countersOffset, 1, sizeof(Counters), length) ||
+        !fits(header.slabTableOffset, header.numSlabs, sizeof(SlabEntry), length) ||
+        !fits(header.freeListsOffset, header.numFreeLists, sizeof(std::uint64_t), length))
+        return false;
+
+    KeyArena arena;
+    for (std::uint64_t i = 0; i < header.numSlabs; i++) {
+        SlabEntry entry;
+        std::memcpy(&entry, base + header.slabTableOffset + i * sizeof(SlabEntry), sizeof(entry));
+        if (entry.capacity == 0 || !fits(entry.offset, entry.capacity, 1, length))
+            return false;
+        arena.slabs.push_back({mapping, base + entry.offset, static_cast<std::size_t>(entry.capacity)});
+    }
+    const char *handles = base + header.freeListsOffset + header.numFreeLists * sizeof(std::uint64_t);
+    std::uint64_t numHandles = 0;
+    arena.freeLists.resize(header.numFreeLists);
+    for (std::uint64_t c = 0; c < header.numFreeLists; c++) {
+        std::uint64_t count;
+        std::memcpy(&count, base + header.freeListsOffset + c * sizeof(count), sizeof(count));
+        auto& list = arena.freeLists[c];
+        if (!fits(static_cast<std::uint64_t>(handles - base), count, sizeof(KeyArena::Handle), length))
+            return false;
+        list.resize(count);
+        if (count > 0)
+            std::memcpy(list.data(), handles, count * sizeof(KeyArena::Handle));
+        for (KeyArena::Handle handle : list)
+            if (!arena.holds(handle, c * KeyArena::GRANULE))
+                return false;
+        handles += count * sizeof(KeyArena::Handle);
+        numHandles += count;
+    }
+    if (numHandles != header.numFreeHandles)
+        return false;
+    if (header.currentSlab < header.numSlabs ? header.slabUsed > arena.slabs[header.currentSlab].capacity
+                                             : header.slabUsed != 0)
+        return false;
+    Counters counters;
+    std::memcpy(&counters, base + header.countersOffset, sizeof(Counters));
+    if (counters.numberOfActive < 0 || counters.numberOfTombstones < 0 ||
+        static_cast<std::uint64_t>(counters.numberOfActive) + static_cast<std::uint64_t>(counters.numberOfTombstones) > n)
+        return false;
+
+    // CHECK_CELLS: every key a probe can reach has to lie within the
+    // snapshot, inline keys within their cell and long ones within a slab,
+    // and the cells have to add up to the counters.
+    const auto *ctrl = reinterpret_cast<const std::uint8_t *>(base + header.controlsOffset);
+    const auto *cells = reinterpret_cast<const KeySlot *>(base + header.keysOffset);
+    const auto *distances = reinterpret_cast<const std::uint32_t *>(base + header.distancesOffset);
+    std::int64_t numUsed = 0, numDeleted = 0;
+    for (std::uint64_t i = 0; check == CHECK_CELLS && i < n; i++) {
+        if (!isUsed(ctrl[i])) {
+            if (ctrl[i] == DELETED_CONTROL)
+                numDeleted++;
+            else if (ctrl[i] != AVAILABLE_CONTROL)
+                return false;
+            continue;
+        }
+        numUsed++;
+        if (distances[i] >= n)
+            return false;
+        if (cells[i].length != KeySlot::IN_ARENA) {
+            if (cells[i].length > KeySlot::INLINE_CAPACITY)
+                return false;
+            continue;
+        }
+        KeyArena::Handle handle;
+        std::uint32_t keyLength;
+        std::memcpy(&handle, cells[i].bytes, sizeof(handle));
+        std::memcpy(&keyLength, cells[i].bytes + sizeof(handle), sizeof(keyLength));
+        if (!arena.holds(handle, keyLength))
+            return false;
+    }
+    if (check == CHECK_CELLS && (numUsed != counters.numberOfActive || numDeleted != counters.numberOfTombstones))
+        return false;
+    arena.currentSlab = header.currentSlab;
+    arena.slabUsed = header.slabUsed;
+    arena.reserved = header.reservedBytes;
+    arena.dead = header.deadBytes;
+
+    // The snapshot is consistent; only now is this table replaced.
+    TABLE_SIZE = n;
+    initialTableSize = header.initialTableSize;
+    probeType = static_cast<PROBE_TYPE>(header.probeType);
+    compactionMode = static_cast<COMPACTION_MODE>(header.compactionMode);
+    hashFunction = static_cast<HASH_FUNCTION>(header.hashFunction);
+    shouldCompact = header.shouldCompact != 0;
+    compactionTriggerEffectiveRate = header.compactionTriggerRate;
+    growthLoadFactor = header.growthLoadFactor;
+    migrationStep = header.migrationStep;
+
+    controls.borrow(mapping, reinterpret_cast<std::uint8_t *>(base + header.controlsOffset), n);
+    keys.borrow(mapping, reinterpret_cast<KeySlot *>(base + header.keysOffset), n);
+    probeDistances.borrow(mapping, reinterpret_cast<std::uint32_t *>(base + header.distancesOffset), n);
+    stats = counters;
+    keyArena = std::move(arena);
+    spareArena = KeyArena();
+
+    migrationPhase = IDLE;
+    oldControls = SlotArray<std::uint8_t>();
+    oldKeys = SlotArray<KeySlot>();
+    oldControls.setPlacement(slotPlacement);
+    oldKeys.setPlacement(slotPlacement);
+    migrationCursor = 0;
+    drainingActive = 0;
+    beforeCompaction.clear();
+    afterCompaction.clear();
+    return true;
+}
@@ -0,0 +1,72 @@
+// KeyArena.cpp
+
+#include "KeyArena.hpp"
+#include<algorithm>
+#include<cstring>
+
+KeyArena::Handle KeyArena::store(std::string_view key) {
+    return store(key.size(), [key](char *out) { std::memcpy(out, key.data(), key.size()); });
+}
+
+KeyArena::Handle KeyArena::allocate(std::size_t length) {
+    const std::size_t cls = sizeClass(length);
+    Handle handle;
+    if (cls < freeLists.size() && !freeLists[cls].empty()) {
+        handle = freeLists[cls].back();
+        freeLists[cls].pop_back();
+        dead -= cls * GRANULE;
+    } else {
+        handle = carve(cls * GRANULE);
+    }
+    return handle;
+}
+
+void KeyArena::release(Handle handle, std::uint32_t length) {
+    const std::size_t cls = sizeClass(length);
+    dead += cls * GRANULE;
+    if (cls * GRANULE > SLAB_BYTES)
+        return;
+    if (cls >= freeLists.size())
+        freeLists.resize(cls + 1);
+    freeLists[cls].push_back(handle);
+}
+
+void KeyArena::clear() {
+    slabs.erase(std::remove_if(slabs.begin(), slabs.end(),
+                               [](const Slab& slab) { return slab.capacity != SLAB_BYTES; }),
+                slabs.end());
+    reserved = slabs.size() * SLAB_BYTES;
+    currentSlab = 0;
+    slabUsed = 0;
+    for (auto& list : freeLists)
+        list.clear();
+    dead = 0;
+}
+
+KeyArena::Slab KeyArena::newSlab(std::size_t capacity) {
+    std::shared_ptr<char[]> bytes(new char[capacity]());
+    return {bytes, bytes.get(), capacity};
+}
+
+KeyArena::Handle KeyArena::carve(std::size_t bytes) {
+    if (bytes > SLAB_BYTES) {
+        slabs.push_back(newSlab(bytes));
+        reserved += bytes;
+        return static_cast<Handle>(slabs.size() - 1) << 32;
+    }
+    // Slabs past currentSlab are either unused or oversized, so moving on
+    // starts a fresh slab. The unused tail of the slab left behind is lost
+    // until the next clear().
+    while (currentSlab < slabs.size() &&
+           (slabs[currentSlab].capacity != SLAB_BYTES || slabUsed + bytes > SLAB_BYTES)) {
+        currentSlab++;
+        slabUsed = 0;
+    }
+    if (currentSlab == slabs.size()) {
+        slabs.push_back(newSlab(SLAB_BYTES));
+        reserved += SLAB_BYTES;
+    }
+    const Handle handle = (static_cast<Handle>(currentSlab) << 32) | slabUsed;
+    slabUsed += bytes;
+    return handle;
+}
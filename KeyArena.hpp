@@ -0,0 +1,85 @@
+// KeyArena.hpp
+// Pooled storage for the keys HashTableDictionary cannot keep inline.
+// Keys are copied into large slabs and identified by a Handle, so storing
+// one allocates only when a slab fills up, and clear() keeps the slabs.
+// Slabs restored by HashTableDictionary::load() borrow their bytes from the
+// snapshot mapping instead of owning them.
+
+#ifndef HASHTABLESOPENADDRESSING_KEYARENA_HPP
+#define HASHTABLESOPENADDRESSING_KEYARENA_HPP
+
+#include<vector>
+#include<memory>
+#include<string_view>
+#include<cstdint>
+
+class KeyArena {
+public:
+    // Slab index in the high 32 bits, byte offset within the slab in the low 32.
+    using Handle = std::uint64_t;
+
+    KeyArena() = default;
+    // A copy would share the slabs, and so the bytes of every long key,
+    // with the original.
+    KeyArena( const KeyArena& ) = delete;
+    KeyArena& operator=( const KeyArena& ) = delete;
+    KeyArena( KeyArena&& ) noexcept = default;
+    KeyArena& operator=( KeyArena&& ) noexcept = default;
+
+    Handle store( std::string_view key );
+    // Stores a key of length bytes that write(char *out) copies into place.
+    template<typename Write>
+    Handle store( std::size_t length, Write write ) {
+        const Handle handle = allocate(length);
+        write(slabs[handle >> 32].bytes + (handle & 0xFFFFFFFFu));
+        return handle;
+    }
+    [[nodiscard]] std::string_view view( Handle handle, std::uint32_t length ) const {
+        return {slabs[handle >> 32].bytes + (handle & 0xFFFFFFFFu), length};
+    }
+    // Whether handle names bytes that lie within one of the slabs.
+    [[nodiscard]] bool holds( Handle handle, std::size_t bytes ) const {
+        const std::size_t slab = handle >> 32;
+        return slab < slabs.size() && bytes <= slabs[slab].capacity &&
+               (handle & 0xFFFFFFFFu) <= slabs[slab].capacity - bytes;
+    }
+    // Puts the key's bytes on the free list of its size class, where the
+    // next store() of a key of that class will reuse them.
+    void release( Handle handle, std::uint32_t length );
+    // Forgets every key but keeps the standard-size slabs for reuse.
+    void clear();
+
+    [[nodiscard]] std::size_t reservedBytes() const { return reserved; }
+    // Bytes released and not reused yet.
+    [[nodiscard]] std::size_t deadBytes() const { return dead; }
+
+private:
+    static constexpr std::size_t SLAB_BYTES = 64 * 1024;
+    static constexpr std::size_t GRANULE = 8;
+    static std::size_t sizeClass( std::size_t length ) { return (length + GRANULE - 1) / GRANULE; }
+
+    struct Slab {
+        std::shared_ptr<void> owner;
+        char *bytes;
+        std::size_t capacity;
+    };
+    static Slab newSlab( std::size_t capacity );
+
+    Handle allocate( std::size_t length );
+    Handle carve( std::size_t bytes );
+
+    // Writes and restores the arena in snapshots.
+    friend class HashTableDictionary;
+
+    // Keys longer than SLAB_BYTES get a slab of their own; those are never on
+    // a free list and are dropped by clear().
+    std::vector<Slab> slabs;
+    std::size_t currentSlab = 0;
+    std::size_t slabUsed = 0;
+    std::vector<std::vector<Handle>> freeLists;     // indexed by size class
+    std::size_t reserved = 0;
+    std::size_t dead = 0;
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_KEYARENA_HPP
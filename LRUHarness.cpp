@@ -2,6 +2,9 @@
 // Timing harness for LRU profile traces.
 // Uses provided HashTableDictionary and Operations.hpp
 // to replay lru_profile_N_*_S_23.trace files and emit CSV lines.
+// With --jobs, conditions run on a pool of pinned worker threads; rows are
+// still printed in the serial order. --reader-bench writes a second CSV
+// with concurrent member() throughput, with and without a writer.
 
 #include <iostream>
 #include <fstream>
@@ -10,74 +13,25 @@
 #include <vector>
 #include <chrono>
 #include <algorithm>
+#include <charconv>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "HashTableDictionary.hpp"
+#include "ShardedHashTableDictionary.hpp"
+#include "LeftRightHashTableDictionary.hpp"
 #include "Operations.hpp"
-
-// ---------- Trace loader (copied from main.cpp) ----------
-// The first line of the header must contain:  <profile> <N> <seed>
-// After the header: blank lines and lines starting with '#' are ignored.
-// Opcodes: I <word1> <word2>  | E <word1> <word2>
-
-bool load_trace_strict_header(const std::string &path,
-                              std::size_t &N,
-                              std::vector<Operation> &out_operations) {
-    std::string profile = "";
-    int seed = 0;
-    out_operations.clear();
-
-    std::ifstream in(path);
-    if (!in.is_open())
-        return false;
-
-    // --- read FIRST line as header
-    std::string header;
-    if (!std::getline(in, header))
-        return false;
-
-    // Look for a non-white-space character
-    const auto first = header.find_first_not_of(" \t\r\n");
-    // Since this is the first line, we don't expect it to be blank
-    // or start with a comment.
-    if (first == std::string::npos || header[first] == '#')
-        return false;
-
-    // Create a string stream so that we can read the profile name,
-    // N, and the seed more easily.
-    std::istringstream hdr(header);
-    if (!(hdr >> profile >> N >> seed))
-        return false;
-
-    // --- read ops, allowing comments/blank lines AFTER the header ---
-    std::string line;
-    while (std::getline(in, line)) {
-        const auto opCodeIdx = line.find_first_not_of(" \t\r\n");
-        if (opCodeIdx == std::string::npos || line[opCodeIdx] == '#')
-            continue; // skip blank and comment lines.
-
-        std::istringstream iss(line.substr(opCodeIdx));
-        std::string tok;
-        if (!(iss >> tok))
-            continue;
-
-        // In the provided traces, each key is stored as two tokens,
-        // which we join with a space to form the full string key.
-        std::string w1, w2;
-        if (tok == "I") {
-            if (!(iss >> w1 >> w2)) return false;
-            out_operations.emplace_back(OpCode::Insert, w1.append(" ") + w2);
-        } else if (tok == "E") {
-            if (!(iss >> w1 >> w2)) return false;
-            out_operations.emplace_back(OpCode::Erase, w1.append(" ") + w2);
-        } else {
-            std::cout << "Unknown operation in load_trace_strict_header: "
-                      << tok << std::endl;
-            return false; // unknown token
-        }
-    }
-
-    return true;
-}
+#include "TraceReader.hpp"
+#include "LatencyHistogram.hpp"
+#include "PerfCounters.hpp"
 
 // ---------- Mapping from N to table size M (copied from main.cpp) ----------
 
@@ -100,9 +54,9 @@ std::size_t tableSizeForN(std::size_t N) {
         if (item.first == N)
             return item.second;
     }
-    std::cout << "Unable to find table size for " << N
-              << " in tableSizeForN." << std::endl;
-    std::exit(1);
+    // Other Ns, e.g. of generated traces: the first prime past N / 0.8,
+    // about the same load factor as the listed sizes.
+    return HashTableDictionary::nextPrime(N + N / 4);
 }
 
 // ---------- Small helpers ----------
@@ -113,9 +67,137 @@ double median_of(std::vector<double> v) {
     return v[v.size() / 2];
 }
 
+// Per-operation latencies of one replay, in nanoseconds: all operations,
+// and split by kind, by outcome (an insert "hits" when the key is already
+// present, a remove or lookup when it is found) and by whether the operation did
+// compaction work (a stop-the-world compaction or growth, or a step of an
+// incremental compaction).
+struct OpLatencies {
+    enum KIND {INSERT, ERASE, LOOKUP, NUM_KINDS};
+    enum OUTCOME {HIT, MISS, NUM_OUTCOMES};
+    enum PHASE {NORMAL, COMPACTING, NUM_PHASES};
+
+    LatencyHistogram all;
+    LatencyHistogram by[NUM_KINDS][NUM_OUTCOMES][NUM_PHASES];
+
+    static std::string categoryName(int kind, int outcome, int phase) {
+        static const char *kinds[] = {"insert", "erase", "lookup"};
+        static const char *outcomes[] = {"hit", "miss"};
+        static const char *phases[] = {"", "_compacting"};
+        return std::string(kinds[kind]) + "_" + outcomes[outcome] + phases[phase];
+    }
+
+    static KIND kindOf(OpCode tag) {
+        switch (tag) {
+            case OpCode::Insert:
+                return INSERT;
+            case OpCode::Erase:
+                return ERASE;
+            case OpCode::Lookup:
+                return LOOKUP;
+        }
+        return INSERT;
+    }
+
+    // All operations of kind with outcome, compacting or not.
+    [[nodiscard]] LatencyHistogram outcome(KIND kind, OUTCOME outcome) const {
+        LatencyHistogram merged = by[kind][outcome][NORMAL];
+        merged += by[kind][outcome][COMPACTING];
+        return merged;
+    }
+};
+
+// Same as replay_ops, but times every operation on its own.
+void replay_ops_per_op_ns(HashTableDictionary &table,
+                          const TraceReader &trace, OpLatencies &latencies) {
+    trace.forEachOp([&](const Operation &op) {
+        const int compactionsBefore = table.compactions();
+        const int growthsBefore = table.counters().numGrowths;
+        const bool migratingBefore = table.isMigrating();
+        bool hit = false;
+        auto start = std::chrono::steady_clock::now();
+        switch (op.tag) {
+            case OpCode::Insert:
+                hit = !table.insert(op.key);
+                break;
+            case OpCode::Erase:
+                hit = table.remove(op.key);
+                break;
+            case OpCode::Lookup:
+                hit = table.member(op.key);
+                break;
+        }
+        auto end = std::chrono::steady_clock::now();
+        const auto ns = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        const bool compacting = migratingBefore || table.isMigrating() ||
+                                table.compactions() != compactionsBefore ||
+                                table.counters().numGrowths != growthsBefore;
+        latencies.all.record(ns);
+        latencies.by[OpLatencies::kindOf(op.tag)]
+                    [hit ? OpLatencies::HIT : OpLatencies::MISS]
+                    [compacting ? OpLatencies::COMPACTING : OpLatencies::NORMAL].record(ns);
+    });
+}
+
+// One --latency CSV row per non-empty category, plus one for all operations.
+std::string latency_rows(const std::string &impl, const std::string &tracePath, std::size_t N,
+                         const OpLatencies &latencies) {
+    std::ostringstream rows;
+    auto row = [&](const std::string &category, const LatencyHistogram &h) {
+        if (h.count() == 0)
+            return;
+        rows << impl << "," << tracePath << "," << N << "," << category << ","
+             << h.count() << "," << h.mean() << ","
+             << h.valueAtPercentile(0.5) << "," << h.valueAtPercentile(0.9) << ","
+             << h.valueAtPercentile(0.99) << "," << h.valueAtPercentile(0.999) << ","
+             << h.max() << "\n";
+    };
+    row("all", latencies.all);
+    for (int kind = 0; kind < OpLatencies::NUM_KINDS; kind++)
+        for (int outcome = 0; outcome < OpLatencies::NUM_OUTCOMES; outcome++)
+            for (int phase = 0; phase < OpLatencies::NUM_PHASES; phase++)
+                row(OpLatencies::categoryName(kind, outcome, phase), latencies.by[kind][outcome][phase]);
+    return rows.str();
+}
+
+// The main CSV's lookup_hit_* and lookup_miss_* columns; empty for a trace
+// without lookups.
+std::string lookup_columns(const OpLatencies &latencies) {
+    std::ostringstream columns;
+    for (auto outcome : {OpLatencies::HIT, OpLatencies::MISS}) {
+        const LatencyHistogram h = latencies.outcome(OpLatencies::LOOKUP, outcome);
+        columns << ",";
+        if (h.count() > 0)
+            columns << h.mean();
+        columns << ",";
+        if (h.count() > 0)
+            columns << h.valueAtPercentile(0.99);
+    }
+    return columns.str();
+}
+
+// Keeps the compiler from discarding the hashing-only pass.
+volatile std::size_t hash_sink = 0;
+
+// Time spent only hashing the trace's keys the way table does it,
+// i.e. the hashing share of a replay.
+double time_hashing_ms(const HashTableDictionary &table,
+                       const TraceReader &trace) {
+    std::size_t acc = 0;
+    auto start = std::chrono::steady_clock::now();
+    trace.forEachOp([&](const Operation &op) {
+        const auto hk = table.hashKey(op.key);
+        acc += hk.home ^ hk.step ^ hk.fingerprint;
+    });
+    auto end = std::chrono::steady_clock::now();
+    hash_sink = acc;
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
 void replay_ops(HashTableDictionary &table,
-                const std::vector<Operation> &ops) {
-    for (const auto &op : ops) {
+                const TraceReader &trace) {
+    trace.forEachOp([&](const Operation &op) {
         switch (op.tag) {
             case OpCode::Insert:
                 table.insert(op.key);
@@ -123,83 +205,580 @@ void replay_ops(HashTableDictionary &table,
             case OpCode::Erase:
                 (void)table.remove(op.key);
                 break;
+            case OpCode::Lookup:
+                (void)table.member(op.key);
+                break;
         }
+    });
+}
+
+// Same as replay_ops, but hands each run of consecutive operations of the
+// same kind, up to batch of them, to insertBatch()/removeBatch()/memberBatch().
+void replay_ops_batched(HashTableDictionary &table,
+                        const TraceReader &trace, std::size_t batch) {
+    std::vector<std::string_view> pending;
+    pending.reserve(batch);
+    OpCode pending_tag = OpCode::Insert;
+    auto flush = [&] {
+        switch (pending_tag) {
+            case OpCode::Insert:
+                table.insertBatch(pending.data(), pending.size());
+                break;
+            case OpCode::Erase:
+                table.removeBatch(pending.data(), pending.size());
+                break;
+            case OpCode::Lookup:
+                table.memberBatch(pending.data(), pending.size());
+                break;
+        }
+        pending.clear();
+    };
+    trace.forEachOp([&](const Operation &op) {
+        if (!pending.empty() && (op.tag != pending_tag || pending.size() == batch))
+            flush();
+        pending_tag = op.tag;
+        pending.push_back(op.key);
+    });
+    if (!pending.empty())
+        flush();
+}
+
+// One table configuration to replay a trace against.
+struct Condition {
+    HashTableDictionary::PROBE_TYPE probeType;
+    HashTableDictionary::COMPACTION_MODE compactionMode = HashTableDictionary::STOP_THE_WORLD;
+    // Start from a small table and let it grow instead of sizing it for N.
+    bool grow = false;
+    HashTableDictionary::HASH_FUNCTION hashFunction = HashTableDictionary::MODULAR;
+    HashTableDictionary::GROUP_SCAN groupScan = HashTableDictionary::bestGroupScan();
+    // When non-zero, replay through the batch API, this many keys at a time.
+    std::size_t batch = 0;
+    // Huge pages and NUMA placement of the slot arrays (--huge-pages, --numa).
+    slotmemory::Placement placement = {};
+};
+
+const std::size_t GROWTH_INITIAL_SIZE = 67;
+const double GROWTH_LOAD_FACTOR = 0.8;
+
+HashTableDictionary make_table(const Condition &cond, std::size_t M) {
+    HashTableDictionary table(cond.grow ? GROWTH_INITIAL_SIZE : M,
+                              cond.probeType, true, 0.95, cond.compactionMode, cond.hashFunction,
+                              cond.placement);
+    if (cond.grow)
+        table.setGrowthLoadFactor(GROWTH_LOAD_FACTOR);
+    table.setGroupScan(cond.groupScan);
+    return table;
+}
+
+void replay(HashTableDictionary &table, const TraceReader &trace, const Condition &cond) {
+    if (cond.batch > 0)
+        replay_ops_batched(table, trace, cond.batch);
+    else
+        replay_ops(table, trace);
+}
+
+// With --isolate, a condition's timed runs hold timing_gate exclusively
+// and its warm-up holds it shared, so nothing else runs while it is timed.
+std::shared_mutex timing_gate;
+bool isolate_timing = false;
+
+// What --structure writes for each condition's final table: nothing, one
+// JSON object per line, or CSV rows.
+enum STRUCTURE_FORMAT {NO_STRUCTURE, STRUCTURE_JSON, STRUCTURE_CSV};
+STRUCTURE_FORMAT structure_format = NO_STRUCTURE;
+
+// With --latency-histograms (or --latency), one extra replay per condition
+// times every operation for the p50_ns..max_ns and lookup columns, which
+// are left empty otherwise.
+bool collect_latencies = false;
+
+// With --perf, hardware counters are read around every timed replay and
+// reported per operation in extra columns.
+bool collect_perf = false;
+
+// Set by --huge-pages and --numa for every condition.
+slotmemory::Placement slot_placement;
+
+std::string perf_columns_header() {
+    std::string header;
+    for (int e = 0; e < PerfCounters::NUM_EVENTS; e++) {
+        header += "," + PerfCounters::eventName(static_cast<PerfCounters::EVENT>(e)) + "_per_op";
+        if (e == PerfCounters::INSTRUCTIONS)
+            header += ",ipc";
     }
+    return header;
 }
 
-// Run one condition (probeType & compaction) on one trace,
-// produce ONE CSV line.
-void run_condition(const std::string &tracePath,
-                   HashTableDictionary::PROBE_TYPE probeType,
-                   bool doCompact) {
-    std::size_t N = 0;
-    std::vector<Operation> ops;
-
-    if (!load_trace_strict_header(tracePath, N, ops)) {
-        std::cerr << "Failed to load trace " << tracePath << "\n";
-        return;
+// The perf_columns_header() columns for counts totalled over numOps
+// operations; an event that could not be counted gets an empty field.
+std::string perf_columns(const PerfCounters::Counts &totals, double numOps) {
+    std::ostringstream columns;
+    for (int e = 0; e < PerfCounters::NUM_EVENTS; e++) {
+        columns << ",";
+        if (totals[e] >= 0)
+            columns << static_cast<double>(totals[e]) / numOps;
+        if (e == PerfCounters::INSTRUCTIONS) {
+            columns << ",";
+            if (totals[PerfCounters::CYCLES] > 0 && totals[PerfCounters::INSTRUCTIONS] >= 0)
+                columns << static_cast<double>(totals[PerfCounters::INSTRUCTIONS]) /
+                           static_cast<double>(totals[PerfCounters::CYCLES]);
+        }
     }
+    return columns.str();
+}
+
+struct ConditionResult {
+    std::string row;            // the CSV line
+    std::string latencyRows;    // its --latency lines
+    std::string structure;      // its --structure lines
+};
+
+// Run one condition (probeType & compaction) on one loaded trace,
+// produce ONE CSV line.
+ConditionResult run_condition(const std::string &tracePath, const TraceReader &trace,
+                          const Condition &cond) {
+    const std::size_t N = trace.N();
 
     std::size_t M = tableSizeForN(N);
     const int NUM_TIMED_RUNS = 7;
 
     // --- warm-up (untimed) ---
     {
-        HashTableDictionary table(M, probeType, doCompact);
-        replay_ops(table, ops);
+        std::shared_lock<std::shared_mutex> shared(timing_gate, std::defer_lock);
+        if (isolate_timing)
+            shared.lock();
+        HashTableDictionary table = make_table(cond, M);
+        replay(table, trace, cond);
     }
 
-    std::vector<double> times_ms;
-    std::string last_stats;
+    std::vector<double> times_ms, hash_times_ms;
+    std::string last_stats, last_structure;
+    OpLatencies latencies;
+
+    std::unique_lock<std::shared_mutex> exclusive(timing_gate, std::defer_lock);
+    if (isolate_timing)
+        exclusive.lock();
+
+    // Opened by, and so counting, the thread running this condition.
+    std::unique_ptr<PerfCounters> perf;
+    PerfCounters::Counts perf_totals{};
+    if (collect_perf)
+        perf = std::make_unique<PerfCounters>();
 
     // --- timed runs ---
     for (int r = 0; r < NUM_TIMED_RUNS; ++r) {
-        HashTableDictionary table(M, probeType, doCompact);
+        HashTableDictionary table = make_table(cond, M);
 
+        if (perf)
+            perf->start();
         auto start = std::chrono::high_resolution_clock::now();
-        replay_ops(table, ops);
+        replay(table, trace, cond);
         auto end = std::chrono::high_resolution_clock::now();
+        if (perf) {
+            perf->stop();
+            const PerfCounters::Counts counts = perf->read();
+            for (int e = 0; e < PerfCounters::NUM_EVENTS; e++)
+                perf_totals[e] = counts[e] < 0 || perf_totals[e] < 0 ? -1 : perf_totals[e] + counts[e];
+        }
 
         std::chrono::duration<double, std::milli> diff = end - start;
         times_ms.push_back(diff.count());
 
         // Grab CSV stats from the last run
         last_stats = table.csvStats();
+        if (structure_format == STRUCTURE_JSON)
+            last_structure = table.structureStatsJson();
+        else if (structure_format == STRUCTURE_CSV)
+            last_structure = table.structureStatsCsv();
+
+        // Hashing alone, against the final table size
+        hash_times_ms.push_back(time_hashing_ms(table, trace));
+    }
+
+    // --- one extra run with per-op timing, kept out of elapsed_ms ---
+    if (collect_latencies) {
+        HashTableDictionary table = make_table(cond, M);
+        replay_ops_per_op_ns(table, trace, latencies);
     }
+    if (exclusive.owns_lock())
+        exclusive.unlock();
 
     double med_ms = median_of(times_ms);
-    std::size_t ops_total = ops.size();
+    std::size_t ops_total = trace.size();
 
-    // Seed is fixed to 23 for provided LRU traces
-    int seed = 23;
+    const int seed = trace.seed();
 
     std::string impl_name =
-        (probeType == HashTableDictionary::SINGLE)
-        ? "hash_map_single"
-        : "hash_map_double";
-
-    std::cout << impl_name << ","
-              << "lru_profile" << ","
-              << tracePath << ","
-              << N << ","
-              << seed << ","
-              << med_ms << ","
-              << ops_total << ","
-              << last_stats
-              << "\n";
+        "hash_map_" + HashTableDictionary::probeTypeName(cond.probeType) +
+        (cond.hashFunction == HashTableDictionary::MODULAR
+             ? "" : "_" + HashTableDictionary::hashFunctionName(cond.hashFunction)) +
+        (cond.grow ? "_growth" : "") +
+        (cond.groupScan == HashTableDictionary::SCALAR ? "_scalar" : "") +
+        (cond.batch > 0 ? "_batch" : "");
+    const std::string placement = slotmemory::placementName(cond.placement);
+    if (!placement.empty())
+        impl_name += "_" + placement;
+
+    std::ostringstream row;
+    row << impl_name << ","
+        << "lru_profile" << ","
+        << tracePath << ","
+        << N << ","
+        << seed << ","
+        << med_ms << ","
+        << ops_total << ",";
+    if (collect_latencies)
+        row << latencies.all.valueAtPercentile(0.5) << ","
+            << latencies.all.valueAtPercentile(0.9) << ","
+            << latencies.all.valueAtPercentile(0.99) << ","
+            << latencies.all.valueAtPercentile(0.999) << ","
+            << latencies.all.max()
+            << lookup_columns(latencies) << ",";
+    else
+        row << ",,,,,,,,,";
+    row << median_of(hash_times_ms) << ","
+        << last_stats;
+    if (perf)
+        row << perf_columns(perf_totals, static_cast<double>(ops_total) * NUM_TIMED_RUNS);
+    row << "\n";
+    // Label the structure lines with the condition.
+    std::string structure;
+    if (structure_format == STRUCTURE_JSON) {
+        structure = "{\"impl\":\"" + impl_name + "\",\"trace_path\":\"" + tracePath +
+                    "\",\"N\":" + std::to_string(N) + ",\"stats\":" + last_structure + "}\n";
+    } else if (structure_format == STRUCTURE_CSV) {
+        std::istringstream lines(last_structure);
+        for (std::string line; std::getline(lines, line); )
+            structure += impl_name + "," + tracePath + "," + std::to_string(N) + "," + line + "\n";
+    }
+    return {row.str(), latency_rows(impl_name, tracePath, N, latencies), structure};
+}
+
+// The conditions run against every trace, in output order.
+std::vector<Condition> conditions_per_trace() {
+    std::vector<Condition> conditions;
+
+    // Try SINGLE and DOUBLE probing with stop-the-world compaction,
+    // then with incremental compaction for the tail-latency comparison.
+    for (auto mode : {HashTableDictionary::STOP_THE_WORLD, HashTableDictionary::INCREMENTAL}) {
+        conditions.push_back({HashTableDictionary::SINGLE, mode});
+        conditions.push_back({HashTableDictionary::DOUBLE, mode});
+    }
+
+    // Backward-shift deletion (also used by Robin Hood) leaves no
+    // tombstones, so these never compact and need only one run.
+    conditions.push_back({HashTableDictionary::SINGLE_BACKSHIFT});
+    conditions.push_back({HashTableDictionary::ROBIN_HOOD});
+
+    // Growth from a small table, sized by the workload instead of N.
+    conditions.push_back({HashTableDictionary::DOUBLE, HashTableDictionary::STOP_THE_WORLD, true});
+    conditions.push_back({HashTableDictionary::ROBIN_HOOD, HashTableDictionary::STOP_THE_WORLD, true});
+
+    // The same probe types with the single-pass 64-bit hash.
+    for (auto probeType : {HashTableDictionary::SINGLE, HashTableDictionary::DOUBLE,
+                           HashTableDictionary::ROBIN_HOOD})
+        conditions.push_back({probeType, HashTableDictionary::STOP_THE_WORLD, false,
+                              HashTableDictionary::WYHASH});
+
+    // Linear probing again with the one-slot-at-a-time scan, for
+    // comparison with the SIMD group scan the other rows use.
+    for (auto probeType : {HashTableDictionary::SINGLE, HashTableDictionary::SINGLE_BACKSHIFT})
+        conditions.push_back({probeType, HashTableDictionary::STOP_THE_WORLD, false,
+                              HashTableDictionary::MODULAR, HashTableDictionary::SCALAR});
+
+    // SINGLE and DOUBLE again, replayed through the prefetching batch API.
+    for (auto probeType : {HashTableDictionary::SINGLE, HashTableDictionary::DOUBLE})
+        conditions.push_back({probeType, HashTableDictionary::STOP_THE_WORLD, false,
+                              HashTableDictionary::MODULAR, HashTableDictionary::bestGroupScan(),
+                              HashTableDictionary::PREFETCH_BATCH});
+    return conditions;
+}
+
+// Pins the calling thread to the worker-th CPU it is allowed to run on,
+// wrapping around when there are more workers than CPUs.
+void pin_to_cpu(unsigned worker) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+        return;
+    unsigned target = worker % static_cast<unsigned>(CPU_COUNT(&allowed));
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- != 0)
+            continue;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+        return;
+    }
+#else
+    (void)worker;
+#endif
+}
+
+// ---------- Concurrent reader benchmark ----------
+
+// Applies one trace operation to any of the dictionaries below.
+template<typename Dictionary>
+void apply_op(Dictionary &dictionary, const Operation &op) {
+    switch (op.tag) {
+        case OpCode::Insert:
+            dictionary.insert(op.key);
+            break;
+        case OpCode::Erase:
+            (void)dictionary.remove(op.key);
+            break;
+        case OpCode::Lookup:
+            (void)dictionary.member(op.key);
+            break;
+    }
+}
+
+const std::size_t READER_SHARDS = 64;
+const int READER_ROUNDS = 3;
+
+// Runs `threads` pinned threads that each call lookup(key) on every key
+// of the trace READER_ROUNDS times, starting at different offsets.
+// Returns the elapsed milliseconds; hits counts the successful lookups.
+template<typename Lookup>
+double time_readers(const std::vector<std::string_view> &keys, unsigned threads,
+                    Lookup lookup, std::size_t &hits) {
+    std::atomic<std::size_t> total_hits{0};
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> readers;
+    for (unsigned t = 0; t < threads; t++) {
+        readers.emplace_back([&, t] {
+            pin_to_cpu(t);
+            ready++;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            std::size_t local_hits = 0;
+            const std::size_t offset = keys.size() / threads * t;
+            for (int round = 0; round < READER_ROUNDS; round++)
+                for (std::size_t i = 0; i < keys.size(); i++)
+                    local_hits += lookup(keys[(offset + i) % keys.size()]) ? 1 : 0;
+            total_hits += local_hits;
+        });
+    }
+    while (ready.load() != threads)
+        std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &reader : readers)
+        reader.join();
+    auto end = std::chrono::steady_clock::now();
+    hits = total_hits.load();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Replays the trace through write(op) on a thread pinned to the first CPU
+// while `threads` readers, pinned to the next ones, keep calling
+// lookup(key) over the trace keys until the replay ends. Returns the
+// replay's elapsed milliseconds; lookups and hits count the readers' calls.
+template<typename Lookup, typename Write>
+double time_readers_with_writer(const TraceReader &trace, const std::vector<std::string_view> &keys,
+                                unsigned threads, Lookup lookup, Write write,
+                                std::size_t &lookups, std::size_t &hits) {
+    std::atomic<std::size_t> total_lookups{0}, total_hits{0};
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false}, done{false};
+    std::vector<std::thread> readers;
+    for (unsigned t = 0; t < threads; t++) {
+        readers.emplace_back([&, t] {
+            pin_to_cpu(t + 1);
+            ready++;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            std::size_t local_lookups = 0, local_hits = 0;
+            std::size_t i = keys.size() / threads * t;
+            while (!done.load(std::memory_order_relaxed)) {
+                local_hits += lookup(keys[i]) ? 1 : 0;
+                local_lookups++;
+                if (++i == keys.size())
+                    i = 0;
+            }
+            total_lookups += local_lookups;
+            total_hits += local_hits;
+        });
+    }
+    std::chrono::steady_clock::time_point start, end;
+    std::thread writer([&] {
+        pin_to_cpu(0);
+        while (ready.load() != threads)
+            std::this_thread::yield();
+        start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        trace.forEachOp(write);
+        end = std::chrono::steady_clock::now();
+        done.store(true);
+    });
+    writer.join();
+    for (auto &reader : readers)
+        reader.join();
+    lookups = total_lookups.load();
+    hits = total_hits.load();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Measures member() throughput from 1, 2, 4, ... reader threads up to the
+// core count, for three implementations: one HashTableDictionary behind a
+// mutex, a ShardedHashTableDictionary, and a LeftRightHashTableDictionary.
+// In read_only mode the trace is replayed first and the readers look up
+// every key READER_ROUNDS times. In with_writer mode the dictionaries
+// start empty and a writer thread replays the trace while the readers run.
+// One CSV row per (implementation, mode, reader count).
+void run_reader_benchmark(std::ostream &out, const std::string &tracePath,
+                          const TraceReader &trace) {
+    const std::size_t M = tableSizeForN(trace.N());
+    std::vector<std::string_view> keys;
+    keys.reserve(trace.size());
+    trace.forEachOp([&](const Operation &op) { keys.push_back(op.key); });
+    if (keys.empty())
+        return;
+
+    auto report = [&](const std::string &impl, const std::string &mode, unsigned threads,
+                      std::size_t shards, std::size_t lookups, std::size_t writes,
+                      double ms, std::size_t hits) {
+        out << impl << "," << mode << "," << tracePath << "," << trace.N() << "," << threads << ","
+            << shards << "," << lookups << "," << writes << "," << ms << ","
+            << static_cast<double>(lookups) / ms / 1000.0 << ","
+            << static_cast<double>(writes) / ms / 1000.0 << ","
+            << (lookups == 0 ? 0.0 : 100.0 * static_cast<double>(hits) / static_cast<double>(lookups)) << "\n";
+    };
+
+    const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (bool with_writer : {false, true}) {
+        const std::string mode = with_writer ? "with_writer" : "read_only";
+        for (unsigned threads = 1; ; threads = std::min(2 * threads, max_threads)) {
+            // Fresh dictionaries for every run, so that each writer replays
+            // the trace from an empty table.
+            HashTableDictionary single(M, HashTableDictionary::DOUBLE, true);
+            std::mutex single_lock;
+            ShardedHashTableDictionary sharded(M, READER_SHARDS, HashTableDictionary::DOUBLE, true);
+            LeftRightHashTableDictionary leftRight(M, HashTableDictionary::DOUBLE, true);
+
+            auto lockedLookup = [&](std::string_view key) {
+                std::lock_guard<std::mutex> guard(single_lock);
+                return single.member(key);
+            };
+            auto lockedWrite = [&](const Operation &op) {
+                std::lock_guard<std::mutex> guard(single_lock);
+                apply_op(single, op);
+            };
+            auto shardedLookup = [&](std::string_view key) { return sharded.member(key); };
+            auto shardedWrite = [&](const Operation &op) { apply_op(sharded, op); };
+            auto leftRightLookup = [&](std::string_view key) { return leftRight.member(key); };
+            auto leftRightWrite = [&](const Operation &op) { apply_op(leftRight, op); };
+
+            std::size_t lookups = 0, hits = 0;
+            double ms = 0.0;
+            if (with_writer) {
+                ms = time_readers_with_writer(trace, keys, threads, lockedLookup, lockedWrite, lookups, hits);
+                report("global_lock", mode, threads, 1, lookups, trace.size(), ms, hits);
+                ms = time_readers_with_writer(trace, keys, threads, shardedLookup, shardedWrite, lookups, hits);
+                report("sharded", mode, threads, sharded.numShards(), lookups, trace.size(), ms, hits);
+                ms = time_readers_with_writer(trace, keys, threads, leftRightLookup, leftRightWrite, lookups, hits);
+                report("left_right", mode, threads, 1, lookups, trace.size(), ms, hits);
+            } else {
+                trace.forEachOp(lockedWrite);
+                trace.forEachOp(shardedWrite);
+                trace.forEachOp(leftRightWrite);
+                lookups = keys.size() * READER_ROUNDS * threads;
+                ms = time_readers(keys, threads, lockedLookup, hits);
+                report("global_lock", mode, threads, 1, lookups, 0, ms, hits);
+                ms = time_readers(keys, threads, shardedLookup, hits);
+                report("sharded", mode, threads, sharded.numShards(), lookups, 0, ms, hits);
+                ms = time_readers(keys, threads, leftRightLookup, hits);
+                report("left_right", mode, threads, 1, lookups, 0, ms, hits);
+            }
+
+            if (threads == max_threads)
+                break;
+        }
+    }
+}
+
+// Parses all of text as a decimal number no larger than max.
+bool parse_unsigned(const std::string &text, unsigned max, unsigned &value) {
+    const char *end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end && value <= max;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
+    unsigned num_workers = 1;
+    bool bad_arguments = false;
+    std::string reader_bench_path;
+    std::string latency_path;
+    std::string structure_path;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            if (!parse_unsigned(argv[++i], 4096, num_workers)) {
+                std::cerr << "--jobs expects a number of threads, not '" << argv[i] << "'\n";
+                bad_arguments = true;
+            } else if (num_workers == 0)
+                num_workers = std::max(1u, std::thread::hardware_concurrency());
+        } else if (arg == "--isolate") {
+            isolate_timing = true;
+        } else if (arg == "--reader-bench" && i + 1 < argc) {
+            reader_bench_path = argv[++i];
+        } else if (arg == "--perf") {
+            collect_perf = true;
+        } else if (arg == "--huge-pages") {
+            slot_placement.pages = slotmemory::HUGE_PAGES;
+        } else if (arg == "--numa" && i + 1 < argc) {
+            const std::string policy = argv[++i];
+            if (policy == "interleave") {
+                slot_placement.numa = slotmemory::INTERLEAVE_NODES;
+            } else {
+                unsigned node = 0;
+                if (!parse_unsigned(policy, 63, node)) {
+                    std::cerr << "--numa expects 'interleave' or a node number up to 63, not '" << policy << "'\n";
+                    bad_arguments = true;
+                }
+                slot_placement.numa = slotmemory::BIND_NODE;
+                slot_placement.node = static_cast<int>(node);
+            }
+        } else if (arg == "--latency-histograms") {
+            collect_latencies = true;
+        } else if (arg == "--latency" && i + 1 < argc) {
+            latency_path = argv[++i];
+            collect_latencies = true;
+        } else if (arg == "--structure" && i + 1 < argc) {
+            structure_path = argv[++i];
+            const bool csv = structure_path.size() >= 4 &&
+                             structure_path.compare(structure_path.size() - 4, 4, ".csv") == 0;
+            structure_format = csv ? STRUCTURE_CSV : STRUCTURE_JSON;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (bad_arguments || positional.size() != 1) {
         std::cerr
             << "Usage: " << argv[0]
-            << " <trace_directory>\n"
+            << " <trace_directory> [--jobs <n>] [--isolate] [--reader-bench <csv>]\n"
+            << "       [--latency-histograms] [--latency <csv>] [--structure <file>] [--perf]\n"
+            << "       [--huge-pages] [--numa <interleave|node>]\n"
+            << "  --jobs <n>              run conditions on n pinned threads (0: one per core)\n"
+            << "  --isolate               never run anything else while a condition is timed\n"
+            << "  --reader-bench <csv>    also write concurrent member() throughput to <csv>\n"
+            << "  --latency-histograms    time every operation in one extra replay per condition for the\n"
+            << "                          p50_ns..max_ns and lookup columns (left empty otherwise)\n"
+            << "  --latency <csv>         as --latency-histograms, and write percentiles per operation category to <csv>\n"
+            << "  --structure <file>      also write probe-length and cluster histograms to <file>\n"
+            << "                          (CSV if it ends in .csv, otherwise one JSON object per line)\n"
+            << "  --perf                  add hardware counters per operation (Linux perf events)\n"
+            << "  --huge-pages            put slot arrays of 2 MB or more on huge pages\n"
+            << "  --numa <interleave|n>   interleave slot arrays over the NUMA nodes, or bind them to node n\n"
             << "Example: " << argv[0]
-            << " lru_profile_trace_files\n";
+            << " lru_profile_trace_files --jobs 0\n";
         return 1;
     }
 
-    std::string traceDir = argv[1];
+    std::string traceDir = positional[0];
 
     // Ns we care about. You already have 1024 and 2048;
     // you can add more when you get more trace files.
@@ -217,22 +796,136 @@ int main(int argc, char *argv[]) {
         1048576
     };
 
+    // Load every trace once; all of its conditions share the reader.
+    struct Job {
+        const std::string *tracePath;
+        const TraceReader *trace;
+        Condition cond;
+    };
+    std::vector<std::string> tracePaths;
+    std::vector<std::unique_ptr<TraceReader>> traces;
+    tracePaths.reserve(Ns.size());
+    for (std::size_t N : Ns) {
+        // Build the expected trace file name, e.g.:
+        //   <traceDir>/lru_profile_N_1024_S_23.trace
+        // A binary version of it (.btrace, see TraceConverter) is streamed
+        // instead when present.
+        const std::string traceBase = traceDir +
+            "/lru_profile_N_" + std::to_string(N) + "_S_23";
+        std::string tracePath = traceBase + ".btrace";
+        if (!std::ifstream(tracePath).good())
+            tracePath = traceBase + ".trace";
+
+        auto trace = std::make_unique<TraceReader>();
+        if (!trace->open(tracePath)) {
+            std::cerr << "Failed to load trace " << tracePath << "\n";
+            continue;
+        }
+        tracePaths.push_back(tracePath);
+        traces.push_back(std::move(trace));
+    }
+    if (collect_perf) {
+        PerfCounters probe;
+        for (int e = 0; e < PerfCounters::NUM_EVENTS; e++)
+            if (!probe.available(static_cast<PerfCounters::EVENT>(e)))
+                std::cerr << "--perf: " << PerfCounters::eventName(static_cast<PerfCounters::EVENT>(e))
+                          << " cannot be counted here; its column stays empty\n";
+    }
+
+    std::vector<Job> jobs;
+    for (std::size_t t = 0; t < traces.size(); t++)
+        for (Condition cond : conditions_per_trace()) {
+            cond.placement = slot_placement;
+            jobs.push_back({&tracePaths[t], traces[t].get(), cond});
+        }
+
     // CSV header
     std::cout << "impl,profile,trace_path,N,seed,elapsed_ms,ops_total,"
+              << "p50_ns,p90_ns,p99_ns,p999_ns,max_ns,"
+              << "lookup_hit_mean_ns,lookup_hit_p99_ns,lookup_miss_mean_ns,lookup_miss_p99_ns,hash_ms,"
               << HashTableDictionary::csvStatsHeader()
+              << (collect_perf ? perf_columns_header() : "")
               << "\n";
 
-    for (std::size_t N : Ns) {
-        // Build the expected trace file name, e.g.:
-        //   <traceDir>/lru_profile_N_1024_S_23.trace
-        std::string tracePath = traceDir +
-            "/lru_profile_N_" + std::to_string(N) + "_S_23.trace";
+    std::ofstream latency_out;
+    if (!latency_path.empty()) {
+        latency_out.open(latency_path);
+        if (!latency_out.is_open()) {
+            std::cerr << "Unable to open " << latency_path << "\n";
+            return 1;
+        }
+        latency_out << "impl,trace_path,N,category,ops,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n";
+    }
+    std::ofstream structure_out;
+    if (!structure_path.empty()) {
+        structure_out.open(structure_path);
+        if (!structure_out.is_open()) {
+            std::cerr << "Unable to open " << structure_path << "\n";
+            return 1;
+        }
+        if (structure_format == STRUCTURE_CSV)
+            structure_out << "impl,trace_path,N," << HashTableDictionary::structureStatsCsvHeader() << "\n";
+    }
+
+    // Workers take jobs in order; a finished row is held back until every
+    // row before it has been printed.
+    std::vector<ConditionResult> rows(jobs.size());
+    std::vector<bool> finished(jobs.size(), false);
+    std::size_t next_to_print = 0;
+    std::mutex output_mutex;
+    std::atomic<std::size_t> next_job{0};
+
+    auto worker = [&](unsigned id) {
+        if (num_workers > 1)
+            pin_to_cpu(id);
+        for (std::size_t j; (j = next_job++) < jobs.size(); ) {
+            ConditionResult result = run_condition(*jobs[j].tracePath, *jobs[j].trace, jobs[j].cond);
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            rows[j] = std::move(result);
+            finished[j] = true;
+            for (; next_to_print < jobs.size() && finished[next_to_print]; next_to_print++) {
+                std::cout << rows[next_to_print].row << std::flush;
+                if (latency_out.is_open())
+                    latency_out << rows[next_to_print].latencyRows << std::flush;
+                if (structure_out.is_open())
+                    structure_out << rows[next_to_print].structure << std::flush;
+                rows[next_to_print] = ConditionResult{};
+            }
+        }
+    };
 
-        // Try SINGLE probing with compaction on
-        run_condition(tracePath, HashTableDictionary::SINGLE, true);
+    if (num_workers == 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned id = 0; id < num_workers; id++)
+            pool.emplace_back(worker, id);
+        for (auto &thread : pool)
+            thread.join();
+    }
+
+    if (slot_placement.pages == slotmemory::HUGE_PAGES || slot_placement.numa != slotmemory::DEFAULT_NODES) {
+        // Falling back is silent, so say what the slot arrays ended up on.
+        const slotmemory::PlacementTotals totals = slotmemory::placementTotals();
+        const double MiB = 1 << 20;
+        std::cerr << "slot arrays: " << totals.hugetlbBytes / MiB << " MiB on reserved huge pages, "
+                  << totals.transparentBytes / MiB << " MiB advised for transparent huge pages, "
+                  << totals.defaultPageBytes / MiB << " MiB on default pages; "
+                  << totals.numaFailures << " NUMA policies refused\n";
+    }
 
-        // Try DOUBLE probing with compaction on
-        run_condition(tracePath, HashTableDictionary::DOUBLE, true);
+    // Runs after the timing sweep, which it would otherwise disturb.
+    if (!reader_bench_path.empty()) {
+        std::ofstream bench(reader_bench_path);
+        if (!bench.is_open()) {
+            std::cerr << "Unable to open " << reader_bench_path << "\n";
+            return 1;
+        }
+        bench << "impl,mode,trace_path,N,readers,shards,lookups,writes,elapsed_ms,"
+                 "lookup_mops_per_s,write_mops_per_s,hit_pct\n";
+        for (std::size_t t = 0; t < traces.size(); t++)
+            run_reader_benchmark(bench, tracePaths[t], *traces[t]);
     }
 
     return 0;
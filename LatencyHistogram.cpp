@@ -0,0 +1,67 @@
+// LatencyHistogram.cpp
+
+#include "LatencyHistogram.hpp"
+#include<algorithm>
+#include<cmath>
+
+LatencyHistogram::LatencyHistogram(): counts(NUM_BUCKETS, 0) {}
+
+std::size_t LatencyHistogram::bucketOf(std::uint64_t value) {
+    if (value < SUB_BUCKETS)
+        return static_cast<std::size_t>(value);
+    // Keep the SUB_BUCKET_BITS most significant bits of value. They lie in
+    // [HALF_SUB_BUCKETS, SUB_BUCKETS), so each shift owns HALF_SUB_BUCKETS
+    // consecutive buckets, following on from the exact ones.
+    const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+    const unsigned shift = msb - SUB_BUCKET_BITS + 1;
+    return static_cast<std::size_t>(shift * HALF_SUB_BUCKETS + (value >> shift));
+}
+
+std::uint64_t LatencyHistogram::highestValueIn(std::size_t bucket) {
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    const std::uint64_t shift = bucket / HALF_SUB_BUCKETS - 1;
+    const std::uint64_t top = bucket - shift * HALF_SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t value) {
+    counts[bucketOf(value)]++;
+    numSamples++;
+    maxValue = std::max(maxValue, value);
+    sum += static_cast<long double>(value);
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < NUM_BUCKETS; i++)
+        counts[i] += other.counts[i];
+    numSamples += other.numSamples;
+    maxValue = std::max(maxValue, other.maxValue);
+    sum += other.sum;
+    return *this;
+}
+
+void LatencyHistogram::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    numSamples = 0;
+    maxValue = 0;
+    sum = 0;
+}
+
+double LatencyHistogram::mean() const {
+    return numSamples == 0 ? 0.0 : static_cast<double>(sum / static_cast<long double>(numSamples));
+}
+
+std::uint64_t LatencyHistogram::valueAtPercentile(double p) const {
+    if (numSamples == 0)
+        return 0;
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(numSamples))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank)
+            return std::min(highestValueIn(i), maxValue);
+    }
+    return maxValue;
+}
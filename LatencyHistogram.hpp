@@ -0,0 +1,47 @@
+// LatencyHistogram.hpp
+// A log-bucketed histogram of non-negative integer samples, such as
+// per-operation latencies in nanoseconds, in the style of HdrHistogram.
+// Values below SUB_BUCKETS are counted exactly. Above that, every power of
+// two is split into SUB_BUCKETS / 2 equal buckets, so a reported value is
+// within 1/32 (about 3%) of the recorded one. Recording is a few shifts and
+// an increment, and the memory use is fixed whatever the range.
+
+#ifndef HASHTABLESOPENADDRESSING_LATENCYHISTOGRAM_HPP
+#define HASHTABLESOPENADDRESSING_LATENCYHISTOGRAM_HPP
+
+#include<cstdint>
+#include<vector>
+
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record( std::uint64_t value );
+    LatencyHistogram& operator+=( const LatencyHistogram& other );
+    void clear();
+
+    [[nodiscard]] std::uint64_t count() const { return numSamples; }
+    [[nodiscard]] std::uint64_t max() const { return maxValue; }
+    [[nodiscard]] double mean() const;
+    // The smallest recorded value v such that a fraction p (0 < p <= 1) of
+    // the samples is at most v, rounded up to the end of v's bucket but never
+    // above max(). 0 when the histogram is empty.
+    [[nodiscard]] std::uint64_t valueAtPercentile( double p ) const;
+
+private:
+    static constexpr unsigned SUB_BUCKET_BITS = 6;
+    static constexpr std::uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+    static constexpr std::uint64_t HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+    static constexpr std::size_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 2) * HALF_SUB_BUCKETS;
+
+    static std::size_t bucketOf( std::uint64_t value );
+    static std::uint64_t highestValueIn( std::size_t bucket );
+
+    std::vector<std::uint64_t> counts;
+    std::uint64_t numSamples = 0;
+    std::uint64_t maxValue = 0;
+    long double sum = 0;
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_LATENCYHISTOGRAM_HPP
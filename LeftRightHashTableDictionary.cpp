@@ -0,0 +1,107 @@
+// LeftRightHashTableDictionary.cpp
+
+#include "LeftRightHashTableDictionary.hpp"
+#include<functional>
+#include<thread>
+
+LeftRightHashTableDictionary::LeftRightHashTableDictionary(std::size_t tableSize,
+                                                           HashTableDictionary::PROBE_TYPE probeType, bool doCompact,
+                                                           double compactionTriggerRate,
+                                                           HashTableDictionary::COMPACTION_MODE compactionMode,
+                                                           HashTableDictionary::HASH_FUNCTION hashFunction):
+    tables{HashTableDictionary(tableSize, probeType, doCompact, compactionTriggerRate, compactionMode, hashFunction),
+           HashTableDictionary(tableSize, probeType, doCompact, compactionTriggerRate, compactionMode, hashFunction)} {
+}
+
+bool LeftRightHashTableDictionary::member(std::string_view v) const {
+    return lookup(v);
+}
+
+bool LeftRightHashTableDictionary::member(const HashTableDictionary::JoinedKey& key) const {
+    return lookup(key);
+}
+
+template<typename Key>
+bool LeftRightHashTableDictionary::lookup(const Key& key) const {
+    // All of these are sequentially consistent: the writer must not miss a
+    // reader that has arrived, and that reader must then see leftRight as the
+    // writer left it.
+    ReadIndicator& indicator = readIndicators[versionIndex.load()];
+    indicator.arrive();
+    const bool found = tables[leftRight.load()].contains(key);
+    indicator.depart();
+    return found;
+}
+
+bool LeftRightHashTableDictionary::insert(std::string_view v) {
+    return write([v](HashTableDictionary& table) { return table.insert(v); });
+}
+
+bool LeftRightHashTableDictionary::remove(std::string_view v) {
+    return write([v](HashTableDictionary& table) { return table.remove(v); });
+}
+
+bool LeftRightHashTableDictionary::insert(const HashTableDictionary::JoinedKey& key) {
+    return write([&key](HashTableDictionary& table) { return table.insert(key); });
+}
+
+bool LeftRightHashTableDictionary::remove(const HashTableDictionary::JoinedKey& key) {
+    return write([&key](HashTableDictionary& table) { return table.remove(key); });
+}
+
+void LeftRightHashTableDictionary::setGrowthLoadFactor(double loadFactor) {
+    write([loadFactor](HashTableDictionary& table) {
+        table.setGrowthLoadFactor(loadFactor);
+        return true;
+    });
+}
+
+std::size_t LeftRightHashTableDictionary::size() const {
+    ReadIndicator& indicator = readIndicators[versionIndex.load()];
+    indicator.arrive();
+    const std::size_t count = tables[leftRight.load()].size();
+    indicator.depart();
+    return count;
+}
+
+std::string LeftRightHashTableDictionary::csvStats() {
+    std::lock_guard<std::mutex> guard(writerLock);
+    return tables[leftRight.load()].csvStats();
+}
+
+template<typename Update>
+bool LeftRightHashTableDictionary::write(Update update) {
+    std::lock_guard<std::mutex> guard(writerLock);
+    const int readersUse = leftRight.load();
+    const bool result = update(tables[1 - readersUse]);
+    leftRight.store(1 - readersUse);
+    toggleVersionAndWait();
+    // No reader can be in tables[readersUse] any more.
+    update(tables[readersUse]);
+    return result;
+}
+
+void LeftRightHashTableDictionary::toggleVersionAndWait() {
+    // Readers that arrived before the switch of leftRight may still be using
+    // the old copy. They are registered on one of the two indicators; new
+    // readers are steered to the other one, and both are drained in turn.
+    const int previous = versionIndex.load();
+    const int next = 1 - previous;
+    while (!readIndicators[next].isEmpty())
+        std::this_thread::yield();
+    versionIndex.store(next);
+    while (!readIndicators[previous].isEmpty())
+        std::this_thread::yield();
+}
+
+bool LeftRightHashTableDictionary::ReadIndicator::isEmpty() const {
+    for (const Slot& slot : slots)
+        if (slot.readers.load() != 0)
+            return false;
+    return true;
+}
+
+std::size_t LeftRightHashTableDictionary::ReadIndicator::slotOfThisThread() {
+    static thread_local const std::size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_SLOTS;
+    return slot;
+}
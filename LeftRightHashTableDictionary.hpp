@@ -0,0 +1,86 @@
+// LeftRightHashTableDictionary.hpp
+// A HashTableDictionary whose member() never takes a lock, for read-mostly
+// use by many threads and one writer at a time.
+//
+// It keeps two copies of the table (the left-right technique). Readers
+// only ever look at the copy that leftRight points to. A writer updates
+// the other copy, points readers at it, waits until no reader can still be
+// in the old copy, and then repeats the update there. Readers never wait
+// and never see a table that is being modified, at the cost of doing
+// every update twice and holding two tables.
+
+#ifndef HASHTABLESOPENADDRESSING_LEFTRIGHTHASHTABLEDICTIONARY_HPP
+#define HASHTABLESOPENADDRESSING_LEFTRIGHTHASHTABLEDICTIONARY_HPP
+
+#include<atomic>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<string_view>
+
+#include "HashTableDictionary.hpp"
+
+class LeftRightHashTableDictionary {
+public:
+    LeftRightHashTableDictionary( std::size_t tableSize,
+        HashTableDictionary::PROBE_TYPE probeType, bool doCompact=false, double compactionTriggerRate=0.95,
+        HashTableDictionary::COMPACTION_MODE compactionMode=HashTableDictionary::STOP_THE_WORLD,
+        HashTableDictionary::HASH_FUNCTION hashFunction=HashTableDictionary::MODULAR );
+
+    // Wait-free; any number of threads. Lookups are not counted in the
+    // statistics.
+    [[nodiscard]] bool member( std::string_view v ) const;
+    [[nodiscard]] bool member( const HashTableDictionary::JoinedKey& key ) const;
+    [[nodiscard]] bool member( std::string_view w1, std::string_view w2 ) const {
+        return member(HashTableDictionary::JoinedKey(w1, w2));
+    }
+
+    // Writers are serialized with a mutex; each waits for readers to leave
+    // the copy it is about to update.
+    bool insert( std::string_view v );
+    bool remove( std::string_view v );
+    // Two-part keys; see HashTableDictionary::JoinedKey.
+    bool insert( const HashTableDictionary::JoinedKey& key );
+    bool remove( const HashTableDictionary::JoinedKey& key );
+    bool insert( std::string_view w1, std::string_view w2 ) { return insert(HashTableDictionary::JoinedKey(w1, w2)); }
+    bool remove( std::string_view w1, std::string_view w2 ) { return remove(HashTableDictionary::JoinedKey(w1, w2)); }
+    void setGrowthLoadFactor( double loadFactor );
+
+    [[nodiscard]] std::size_t size() const;
+    // Statistics of the copy readers currently use. Call from the writer.
+    std::string csvStats();
+
+private:
+    // A counter per group of reader threads, each on its own cache line, so
+    // that readers on different cores do not contend on one counter.
+    class ReadIndicator {
+    public:
+        void arrive() { slots[slotOfThisThread()].readers.fetch_add(1); }
+        void depart() { slots[slotOfThisThread()].readers.fetch_sub(1); }
+        [[nodiscard]] bool isEmpty() const;
+    private:
+        static constexpr std::size_t NUM_SLOTS = 64;
+        static std::size_t slotOfThisThread();
+        struct alignas(64) Slot {
+            std::atomic<std::int64_t> readers{0};
+        };
+        Slot slots[NUM_SLOTS];
+    };
+
+    // Applies update to the copy readers are not using, switches readers
+    // over, and applies it to the other copy. Returns the first result.
+    template<typename Key>
+    [[nodiscard]] bool lookup( const Key& key ) const;
+    template<typename Update>
+    bool write( Update update );
+    void toggleVersionAndWait();
+
+    HashTableDictionary tables[2];
+    std::atomic<int> leftRight{0};          // the copy readers use
+    std::atomic<int> versionIndex{0};       // the indicator new readers arrive at
+    mutable ReadIndicator readIndicators[2];
+    std::mutex writerLock;
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_LEFTRIGHTHASHTABLEDICTIONARY_HPP
@@ -0,0 +1,398 @@
+// OpenAddressedSet.hpp
+// A header-only open-addressed hash set templated on key type, hash and
+// equality, for keys other than the trace strings HashTableDictionary is
+// built around (it keeps its arena, string hashes and compaction modes).
+//
+// Both versions probe linearly over a power-of-two table. A key's home slot
+// is the top bits of its hash times 2^64 divided by the golden ratio
+// (multiplicative hashing), so Hash may be as simple as the identity, as
+// std::hash is for integers.
+//
+// The general version keeps one control byte per slot, encoded like
+// HashTableDictionary's: AVAILABLE, DELETED, or a 7-bit fingerprint of the
+// live key, so that Equal only runs on likely matches. For 32- and 64-bit
+// integer keys compared with std::equal_to, a specialization stores the
+// keys alone: the two largest values of the type mark empty and deleted
+// slots. Those two values can still be members; they are kept in flags
+// outside the table.
+//
+// With a transparent Hash and Equal (both declaring is_transparent), such
+// as the defaults for std::string keys, insert(), member() and remove() also
+// accept any key type those two do, e.g. std::string_view or const char*,
+// and only an insert that adds the key constructs a Key from it.
+//
+// As with HashTableDictionary::setGrowthLoadFactor(), once live keys plus
+// tombstones pass maxLoadFactor an insert rebuilds the table: at the same
+// size when tombstones make up most of the load, otherwise at twice the size.
+
+#ifndef HASHTABLESOPENADDRESSING_OPENADDRESSEDSET_HPP
+#define HASHTABLESOPENADDRESSING_OPENADDRESSEDSET_HPP
+
+#include<algorithm>
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<limits>
+#include<string>
+#include<string_view>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+namespace openaddressing {
+
+// Slot arithmetic and load bookkeeping shared by both versions of the set.
+class TableShape {
+public:
+    static constexpr std::size_t MIN_CAPACITY = 16;
+    static constexpr std::uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+    TableShape( std::size_t expectedSize, double maxLoadFactor_ )
+        : maxLoadFactor(std::min(std::max(maxLoadFactor_, 0.1), 0.99)) {
+        setCapacity(capacityFor(expectedSize));
+    }
+
+    // The smallest capacity that holds n keys without a rebuild.
+    [[nodiscard]] std::size_t capacityFor( std::size_t n ) const {
+        std::size_t capacity = MIN_CAPACITY;
+        while (static_cast<double>(n + 1) > maxLoadFactor * static_cast<double>(capacity))
+            capacity *= 2;
+        return capacity;
+    }
+
+    void setCapacity( std::size_t capacity_ ) {
+        capacity = capacity_;
+        shift = 64;
+        for (std::size_t c = capacity; c > 1; c /= 2)
+            shift--;
+    }
+
+    [[nodiscard]] static std::uint64_t mix( std::uint64_t hash ) { return hash * MULTIPLIER; }
+    [[nodiscard]] std::size_t home( std::uint64_t mixed ) const { return static_cast<std::size_t>(mixed >> shift); }
+    // The 7 bits just below those that pick the home slot, so that keys in
+    // the same cluster rarely share a fingerprint.
+    [[nodiscard]] std::uint8_t fingerprint( std::uint64_t mixed ) const {
+        return static_cast<std::uint8_t>((mixed >> (shift - 7)) & 0x7F);
+    }
+    [[nodiscard]] std::size_t next( std::size_t idx ) const { return (idx + 1) & (capacity - 1); }
+
+    // Whether one more key would take live keys plus tombstones past the
+    // load factor, and the capacity to rebuild at if so.
+    [[nodiscard]] bool full() const {
+        return static_cast<double>(live + tombstones + 1) > maxLoadFactor * static_cast<double>(capacity);
+    }
+    [[nodiscard]] std::size_t rebuildCapacity() const {
+        if (static_cast<double>(live) <= 0.75 * maxLoadFactor * static_cast<double>(capacity))
+            return capacity;
+        return 2 * capacity;
+    }
+
+    std::size_t capacity = 0;
+    unsigned shift = 64;
+    std::size_t live = 0;
+    std::size_t tombstones = 0;
+    double maxLoadFactor;
+};
+
+// Hashes std::string and everything that converts to std::string_view the
+// same way, so that std::string keys can be looked up without a copy.
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()( std::string_view s ) const { return std::hash<std::string_view>()(s); }
+};
+
+template<typename Key>
+struct DefaultHash { using type = std::hash<Key>; };
+template<>
+struct DefaultHash<std::string> { using type = StringHash; };
+
+template<typename Key>
+struct DefaultEqual { using type = std::equal_to<Key>; };
+template<>
+struct DefaultEqual<std::string> { using type = std::equal_to<>; };
+
+template<typename T, typename = void>
+inline constexpr bool isTransparent = false;
+template<typename T>
+inline constexpr bool isTransparent<T, std::void_t<typename T::is_transparent>> = true;
+
+template<typename Key, typename Equal>
+inline constexpr bool hasSentinelKeys =
+    std::is_integral_v<Key> && !std::is_same_v<Key, bool> &&
+    (sizeof(Key) == 4 || sizeof(Key) == 8) && std::is_same_v<Equal, std::equal_to<Key>>;
+
+}
+
+// Key must be default-constructible and movable; a removed key is replaced
+// by Key() so that it releases what it owns.
+template<typename Key, typename Hash = typename openaddressing::DefaultHash<Key>::type,
+         typename Equal = typename openaddressing::DefaultEqual<Key>::type, typename = void>
+class OpenAddressedSet {
+
+    template<typename K>
+    static constexpr bool isLookupKey = openaddressing::isTransparent<Hash> &&
+                                        openaddressing::isTransparent<Equal> && !std::is_same_v<K, Key>;
+
+public:
+    explicit OpenAddressedSet( std::size_t expectedSize = 0, double maxLoadFactor = 0.8,
+                               Hash hash_ = Hash(), Equal equal_ = Equal() )
+        : shape(expectedSize, maxLoadFactor), hash(std::move(hash_)), equal(std::move(equal_)),
+          controls(shape.capacity, AVAILABLE_CONTROL), keys(shape.capacity) {}
+
+    // Returns false if key was already a member.
+    bool insert( const Key& key ) { return insertKey(key); }
+    [[nodiscard]] bool member( const Key& key ) const { return find(key) != NONE; }
+    // Returns false if key was not a member.
+    bool remove( const Key& key ) { return removeAt(find(key)); }
+
+    // The same, for the other key types a transparent Hash and Equal take.
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    bool insert( const K& key ) { return insertKey(key); }
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    [[nodiscard]] bool member( const K& key ) const { return find(key) != NONE; }
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    bool remove( const K& key ) { return removeAt(find(key)); }
+
+    [[nodiscard]] std::size_t size() const { return shape.live; }
+    [[nodiscard]] bool empty() const { return shape.live == 0; }
+    [[nodiscard]] std::size_t capacity() const { return shape.capacity; }
+    [[nodiscard]] std::size_t tombstones() const { return shape.tombstones; }
+    [[nodiscard]] std::size_t memoryBytes() const { return controls.size() + keys.size() * sizeof(Key); }
+
+    void clear() {
+        std::fill(controls.begin(), controls.end(), AVAILABLE_CONTROL);
+        std::fill(keys.begin(), keys.end(), Key());
+        shape.live = shape.tombstones = 0;
+    }
+
+    // Makes room for n keys without further rebuilds.
+    void reserve( std::size_t n ) {
+        if (shape.capacityFor(n) > shape.capacity)
+            rebuild(shape.capacityFor(n));
+    }
+
+    // Calls f(key) for every member, in slot order.
+    template<typename F>
+    void forEach( F f ) const {
+        for (std::size_t i = 0; i < controls.size(); i++)
+            if ((controls[i] & 0x80) == 0)
+                f(keys[i]);
+    }
+
+private:
+    static constexpr std::uint8_t AVAILABLE_CONTROL = 0x80;
+    static constexpr std::uint8_t DELETED_CONTROL = 0xFE;
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    template<typename K>
+    bool insertKey( const K& key ) {
+        if (shape.full())
+            rebuild(shape.rebuildCapacity());
+        const std::uint64_t mixed = mix(hash, key);
+        const std::uint8_t fp = shape.fingerprint(mixed);
+        std::size_t firstDeleted = NONE;
+        std::size_t idx = shape.home(mixed);
+        for (; controls[idx] != AVAILABLE_CONTROL; idx = shape.next(idx)) {
+            if (controls[idx] == DELETED_CONTROL) {
+                if (firstDeleted == NONE)
+                    firstDeleted = idx;
+            } else if (controls[idx] == fp && equal(keys[idx], key)) {
+                return false;
+            }
+        }
+        if (firstDeleted != NONE) {
+            idx = firstDeleted;
+            shape.tombstones--;
+        }
+        controls[idx] = fp;
+        keys[idx] = Key(key);
+        shape.live++;
+        return true;
+    }
+
+    bool removeAt( std::size_t idx ) {
+        if (idx == NONE)
+            return false;
+        keys[idx] = Key();
+        shape.live--;
+        // A probe that reaches an AVAILABLE slot stops there, so nothing
+        // depends on a slot just before one staying occupied.
+        if (controls[shape.next(idx)] == AVAILABLE_CONTROL) {
+            controls[idx] = AVAILABLE_CONTROL;
+        } else {
+            controls[idx] = DELETED_CONTROL;
+            shape.tombstones++;
+        }
+        return true;
+    }
+
+    template<typename K>
+    static std::uint64_t mix( const Hash& h, const K& key ) {
+        return openaddressing::TableShape::mix(static_cast<std::uint64_t>(h(key)));
+    }
+
+    template<typename K>
+    [[nodiscard]] std::size_t find( const K& key ) const {
+        const std::uint64_t mixed = mix(hash, key);
+        const std::uint8_t fp = shape.fingerprint(mixed);
+        for (std::size_t idx = shape.home(mixed); controls[idx] != AVAILABLE_CONTROL; idx = shape.next(idx))
+            if (controls[idx] == fp && equal(keys[idx], key))
+                return idx;
+        return NONE;
+    }
+
+    void rebuild( std::size_t newCapacity ) {
+        std::vector<std::uint8_t> oldControls(newCapacity, AVAILABLE_CONTROL);
+        std::vector<Key> oldKeys(newCapacity);
+        oldControls.swap(controls);
+        oldKeys.swap(keys);
+        shape.setCapacity(newCapacity);
+        shape.tombstones = 0;
+        for (std::size_t i = 0; i < oldControls.size(); i++) {
+            if ((oldControls[i] & 0x80) != 0)
+                continue;
+            const std::uint64_t mixed = mix(hash, oldKeys[i]);
+            std::size_t idx = shape.home(mixed);
+            while (controls[idx] != AVAILABLE_CONTROL)
+                idx = shape.next(idx);
+            controls[idx] = shape.fingerprint(mixed);
+            keys[idx] = std::move(oldKeys[i]);
+        }
+    }
+
+    openaddressing::TableShape shape;
+    Hash hash;
+    Equal equal;
+    std::vector<std::uint8_t> controls;
+    std::vector<Key> keys;
+};
+
+// 32- and 64-bit integer keys: 4 or 8 bytes per slot and no control bytes.
+template<typename Key, typename Hash, typename Equal>
+class OpenAddressedSet<Key, Hash, Equal, std::enable_if_t<openaddressing::hasSentinelKeys<Key, Equal>>> {
+public:
+    explicit OpenAddressedSet( std::size_t expectedSize = 0, double maxLoadFactor = 0.8,
+                               Hash hash_ = Hash(), Equal = Equal() )
+        : shape(expectedSize, maxLoadFactor), hash(std::move(hash_)), slots(shape.capacity, EMPTY_KEY) {}
+
+    // Returns false if key was already a member.
+    bool insert( Key key ) {
+        if (key == EMPTY_KEY || key == DELETED_KEY)
+            return std::exchange(sentinelFlag(key), true) == false;
+        if (shape.full())
+            rebuild(shape.rebuildCapacity());
+        std::size_t firstDeleted = NONE;
+        std::size_t idx = home(key);
+        for (; slots[idx] != EMPTY_KEY; idx = shape.next(idx)) {
+            if (slots[idx] == key)
+                return false;
+            if (slots[idx] == DELETED_KEY && firstDeleted == NONE)
+                firstDeleted = idx;
+        }
+        if (firstDeleted != NONE) {
+            idx = firstDeleted;
+            shape.tombstones--;
+        }
+        slots[idx] = key;
+        shape.live++;
+        return true;
+    }
+
+    [[nodiscard]] bool member( Key key ) const {
+        if (key == EMPTY_KEY || key == DELETED_KEY)
+            return key == EMPTY_KEY ? hasEmptyKey : hasDeletedKey;
+        return find(key) != NONE;
+    }
+
+    // Returns false if key was not a member.
+    bool remove( Key key ) {
+        if (key == EMPTY_KEY || key == DELETED_KEY)
+            return std::exchange(sentinelFlag(key), false);
+        const std::size_t idx = find(key);
+        if (idx == NONE)
+            return false;
+        shape.live--;
+        // As in the general version, a slot just before an empty one can
+        // become empty itself instead of a tombstone.
+        if (slots[shape.next(idx)] == EMPTY_KEY) {
+            slots[idx] = EMPTY_KEY;
+        } else {
+            slots[idx] = DELETED_KEY;
+            shape.tombstones++;
+        }
+        return true;
+    }
+
+    [[nodiscard]] std::size_t size() const { return shape.live + hasEmptyKey + hasDeletedKey; }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+    [[nodiscard]] std::size_t capacity() const { return shape.capacity; }
+    [[nodiscard]] std::size_t tombstones() const { return shape.tombstones; }
+    [[nodiscard]] std::size_t memoryBytes() const { return slots.size() * sizeof(Key); }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), EMPTY_KEY);
+        shape.live = shape.tombstones = 0;
+        hasEmptyKey = hasDeletedKey = false;
+    }
+
+    // Makes room for n keys without further rebuilds.
+    void reserve( std::size_t n ) {
+        if (shape.capacityFor(n) > shape.capacity)
+            rebuild(shape.capacityFor(n));
+    }
+
+    // Calls f(key) for every member: those in the table in slot order, then
+    // the sentinel values.
+    template<typename F>
+    void forEach( F f ) const {
+        for (Key key : slots)
+            if (key != EMPTY_KEY && key != DELETED_KEY)
+                f(key);
+        if (hasDeletedKey)
+            f(DELETED_KEY);
+        if (hasEmptyKey)
+            f(EMPTY_KEY);
+    }
+
+private:
+    static constexpr Key EMPTY_KEY = std::numeric_limits<Key>::max();
+    static constexpr Key DELETED_KEY = EMPTY_KEY - 1;
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    [[nodiscard]] std::size_t home( Key key ) const {
+        return shape.home(openaddressing::TableShape::mix(static_cast<std::uint64_t>(hash(key))));
+    }
+
+    bool& sentinelFlag( Key key ) { return key == EMPTY_KEY ? hasEmptyKey : hasDeletedKey; }
+
+    [[nodiscard]] std::size_t find( Key key ) const {
+        for (std::size_t idx = home(key); slots[idx] != EMPTY_KEY; idx = shape.next(idx))
+            if (slots[idx] == key)
+                return idx;
+        return NONE;
+    }
+
+    void rebuild( std::size_t newCapacity ) {
+        std::vector<Key> oldSlots(newCapacity, EMPTY_KEY);
+        oldSlots.swap(slots);
+        shape.setCapacity(newCapacity);
+        shape.tombstones = 0;
+        for (Key key : oldSlots) {
+            if (key == EMPTY_KEY || key == DELETED_KEY)
+                continue;
+            std::size_t idx = home(key);
+            while (slots[idx] != EMPTY_KEY)
+                idx = shape.next(idx);
+            slots[idx] = key;
+        }
+    }
+
+    openaddressing::TableShape shape;
+    Hash hash;
+    std::vector<Key> slots;
+    bool hasEmptyKey = false;
+    bool hasDeletedKey = false;
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_OPENADDRESSEDSET_HPP
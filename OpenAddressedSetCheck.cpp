@@ -0,0 +1,159 @@
+// OpenAddressedSetCheck.cpp
+// Behaviour checks of OpenAddressedSet, built by default and run by ctest.
+// Both versions of the set (control bytes, and bare integer keys with
+// sentinels) replay the same random insert/remove/member mix as a
+// std::unordered_set and must agree with it after every operation; a few
+// targeted checks cover growth, tombstone rebuilds, the sentinel values and
+// transparent lookups.
+//
+// Usage: OpenAddressedSetCheck   (exits with 1 after reporting any failure)
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "OpenAddressedSet.hpp"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+// Sends every key through one bucket, so that probes run through long
+// clusters and matches depend on the fingerprint and Equal.
+struct CollidingHash {
+    std::size_t operator()(const std::string &) const { return 42; }
+};
+
+template<typename Set, typename Key, typename MakeKey>
+void checkAgainstReference(const std::string &name, Set set, MakeKey makeKey, int numOps, int universe) {
+    std::unordered_set<Key> reference;
+    std::mt19937 rng(7);
+    for (int op = 0; op < numOps; op++) {
+        const Key key = makeKey(static_cast<int>(rng() % static_cast<unsigned>(universe)));
+        switch (rng() % 3) {
+            case 0:
+                check(set.insert(key) == reference.insert(key).second, name + ": insert result");
+                break;
+            case 1:
+                check(set.remove(key) == (reference.erase(key) == 1), name + ": remove result");
+                break;
+            default:
+                check(set.member(key) == (reference.count(key) == 1), name + ": member result");
+        }
+        if (set.size() != reference.size()) {
+            check(false, name + ": size after operation " + std::to_string(op));
+            return;
+        }
+    }
+    std::size_t visited = 0;
+    set.forEach([&](const Key &key) {
+        visited++;
+        check(reference.count(key) == 1, name + ": forEach visits a non-member");
+    });
+    check(visited == reference.size(), name + ": forEach visits every member once");
+    const double load = static_cast<double>(set.size() + set.tombstones()) / static_cast<double>(set.capacity());
+    check(load <= 0.8, name + ": live keys plus tombstones within the load factor");
+    set.clear();
+    check(set.empty() && !set.member(makeKey(0)), name + ": clear");
+}
+
+void checkGrowth() {
+    OpenAddressedSet<std::string> set;
+    const std::size_t initial = set.capacity();
+    for (int i = 0; i < 10000; i++)
+        set.insert("key" + std::to_string(i));
+    check(set.size() == 10000, "growth: size");
+    check(set.capacity() > initial && (set.capacity() & (set.capacity() - 1)) == 0,
+          "growth: capacity doubles to a power of two");
+    bool all = true;
+    for (int i = 0; i < 10000; i++)
+        all = all && set.member("key" + std::to_string(i));
+    check(all && !set.member("key10000"), "growth: members after rebuilds");
+
+    // Churn that keeps the live count small must rebuild in place instead of
+    // growing on tombstones.
+    OpenAddressedSet<std::uint64_t> churn(100);
+    const std::size_t capacity = churn.capacity();
+    for (std::uint64_t i = 0; i < 100000; i++) {
+        churn.insert(i);
+        if (i >= 50)
+            churn.remove(i - 50);
+    }
+    check(churn.size() == 50 && churn.capacity() == capacity, "growth: tombstones do not grow the table");
+
+    OpenAddressedSet<std::uint32_t> reserved;
+    reserved.reserve(1000);
+    const std::size_t afterReserve = reserved.capacity();
+    for (std::uint32_t i = 0; i < 1000; i++)
+        reserved.insert(i);
+    check(reserved.capacity() == afterReserve, "growth: reserve avoids rebuilds");
+}
+
+template<typename Key>
+void checkSentinels(const std::string &name) {
+    // The two values that mark empty and deleted slots are kept outside the
+    // table; they must behave like any other key.
+    const Key empty = std::numeric_limits<Key>::max();
+    const Key deleted = empty - 1;
+    OpenAddressedSet<Key> set;
+    check(set.memoryBytes() == set.capacity() * sizeof(Key), name + ": integer keys are stored bare");
+    check(!set.member(empty) && !set.member(deleted), name + ": sentinels absent at first");
+    check(set.insert(empty) && !set.insert(empty), name + ": insert the empty marker once");
+    check(set.insert(deleted) && !set.insert(deleted), name + ": insert the deleted marker once");
+    check(set.insert(1) && set.size() == 3, name + ": size counts the sentinels");
+    check(set.member(empty) && set.member(deleted) && set.member(1), name + ": sentinels are members");
+    std::size_t visited = 0;
+    set.forEach([&](Key) { visited++; });
+    check(visited == 3, name + ": forEach visits the sentinels");
+    check(set.remove(empty) && !set.remove(empty) && !set.member(empty), name + ": remove the empty marker");
+    check(set.remove(deleted) && !set.member(deleted) && set.member(1), name + ": remove the deleted marker");
+    check(set.size() == 1, name + ": size after removing the sentinels");
+}
+
+void checkTransparentLookups() {
+    OpenAddressedSet<std::string> set;
+    const std::string_view view = "alpha beta";
+    check(set.insert(view) && !set.insert(std::string("alpha beta")), "transparent: insert a string_view");
+    check(set.member("alpha beta") && set.member(view.substr(0, 10)), "transparent: member");
+    check(!set.member(view.substr(0, 5)), "transparent: a prefix is not a member");
+    check(set.remove("alpha beta") && set.empty(), "transparent: remove");
+}
+
+}
+
+int main() {
+    auto word = [](int i) { return "w" + std::to_string(i); };
+    checkAgainstReference<OpenAddressedSet<std::string>, std::string>(
+        "string", OpenAddressedSet<std::string>(), word, 200000, 5000);
+    checkAgainstReference<OpenAddressedSet<std::string, CollidingHash>, std::string>(
+        "colliding string", OpenAddressedSet<std::string, CollidingHash>(), word, 20000, 300);
+    checkAgainstReference<OpenAddressedSet<std::uint64_t>, std::uint64_t>(
+        "uint64", OpenAddressedSet<std::uint64_t>(),
+        [](int i) { return std::numeric_limits<std::uint64_t>::max() - static_cast<std::uint64_t>(i); },
+        200000, 5000);
+    checkAgainstReference<OpenAddressedSet<std::int32_t>, std::int32_t>(
+        "int32", OpenAddressedSet<std::int32_t>(), [](int i) { return (i % 2 ? -i : i) * 7919; }, 200000, 5000);
+    checkGrowth();
+    checkSentinels<std::uint64_t>("uint64 sentinels");
+    checkSentinels<std::uint32_t>("uint32 sentinels");
+    checkSentinels<std::int64_t>("int64 sentinels");
+    checkTransparentLookups();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "OpenAddressedSet: all checks passed\n";
+    return 0;
+}
@@ -5,20 +5,23 @@
 #pragma once
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <iostream>
 
 enum class OpCode {
     Insert,     // I key
-    Erase  // E key (delete a key)
+    Erase,  // E key (delete a key)
+    Lookup  // L key (look a key up)
   };
 
 struct Operation {
     OpCode tag;
-    std::string key;
+    // Refers to bytes owned by whoever loaded the trace (see TraceReader).
+    std::string_view key;
 
-    // Either of the two op_codes take a string argument.
-    Operation(OpCode op_code, const std::string &k) : tag(op_code), key(k) {
-        assert(op_code == OpCode::Insert || op_code == OpCode::Erase);
+    // Each of the op_codes takes a string argument.
+    Operation(OpCode op_code, std::string_view k) : tag(op_code), key(k) {
+        assert(op_code == OpCode::Insert || op_code == OpCode::Erase || op_code == OpCode::Lookup);
     }
 
     void print() const {
@@ -29,6 +32,9 @@ struct Operation {
             case OpCode::Erase:
                 std::cout << "E " << key << std::endl;
                 break;
+            case OpCode::Lookup:
+                std::cout << "L " << key << std::endl;
+                break;
             default:
                 std::cout << "Unknown operation: " << static_cast<int>(tag) << std::endl;
         }
@@ -36,5 +42,15 @@ struct Operation {
     }
     // Identify the instance
     [[nodiscard]] bool isInsert()     const { return tag == OpCode::Insert; }
-    [[nodiscard]] bool isFindMin()    const { return tag == OpCode::Erase; }
+    [[nodiscard]] bool isErase()      const { return tag == OpCode::Erase; }
+    [[nodiscard]] bool isLookup()     const { return tag == OpCode::Lookup; }
 };
+
+// The key "<w1> <w2>" in place, when w2 already follows w1 and a single
+// space in one buffer, as the two words of a trace line do. Otherwise an
+// empty view whose data() is null.
+inline std::string_view joinedInPlace(std::string_view w1, std::string_view w2) {
+    if (w2.data() == w1.data() + w1.size() + 1 && w1.data()[w1.size()] == ' ')
+        return {w1.data(), w1.size() + 1 + w2.size()};
+    return {};
+}
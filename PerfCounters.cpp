@@ -0,0 +1,133 @@
+// PerfCounters.cpp
+
+#include "PerfCounters.hpp"
+#include<algorithm>
+
+#ifdef __linux__
+#include<cstring>
+#include<linux/perf_event.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+
+namespace {
+
+struct EventConfig {
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+std::uint64_t cacheReadMiss(std::uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// In the order of PerfCounters::EVENT.
+const EventConfig EVENT_CONFIGS[PerfCounters::NUM_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+int openEvent(const EventConfig& event) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = 1;
+    // User-space only, which unprivileged processes may count at the
+    // default perf_event_paranoid level.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+}
+
+PerfCounters::PerfCounters() {
+    for (int e = 0; e < NUM_EVENTS; e++)
+        fds[e] = openEvent(EVENT_CONFIGS[e]);
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds)
+        if (fd >= 0)
+            close(fd);
+}
+
+void PerfCounters::start() {
+    for (int fd : fds) {
+        if (fd < 0)
+            continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop() {
+    for (int fd : fds)
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+PerfCounters::Counts PerfCounters::read() const {
+    Counts counts;
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        counts[e] = -1;
+        if (fds[e] < 0)
+            continue;
+        std::uint64_t values[3];    // value, time enabled, time running
+        if (::read(fds[e], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)))
+            continue;
+        if (values[2] == 0) {
+            counts[e] = values[1] == 0 ? 0 : -1;    // enabled but never scheduled
+            continue;
+        }
+        const double scale = static_cast<double>(values[1]) / static_cast<double>(values[2]);
+        counts[e] = static_cast<std::int64_t>(static_cast<double>(values[0]) * scale);
+    }
+    return counts;
+}
+
+#else
+
+PerfCounters::PerfCounters() { fds.fill(-1); }
+PerfCounters::~PerfCounters() = default;
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+
+PerfCounters::Counts PerfCounters::read() const {
+    Counts counts;
+    counts.fill(-1);
+    return counts;
+}
+
+#endif
+
+bool PerfCounters::anyAvailable() const {
+    return std::any_of(fds.begin(), fds.end(), [](int fd) { return fd >= 0; });
+}
+
+std::string PerfCounters::eventName(EVENT event) {
+    switch (event) {
+        case CYCLES:
+            return "cycles";
+        case INSTRUCTIONS:
+            return "instructions";
+        case L1D_MISSES:
+            return "l1d_misses";
+        case LLC_MISSES:
+            return "llc_misses";
+        case BRANCH_MISSES:
+            return "branch_misses";
+        case DTLB_MISSES:
+            return "dtlb_misses";
+        case NUM_EVENTS:
+            break;
+    }
+    return "unknown";
+}
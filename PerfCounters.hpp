@@ -0,0 +1,47 @@
+// PerfCounters.hpp
+// Hardware performance counters for the calling thread, read through Linux
+// perf_event_open(2): cycles, instructions, L1 data-cache and last-level
+// cache read misses, branch misses and data-TLB read misses.
+//
+// Every event is opened on its own, so one the CPU, kernel or permissions
+// (kernel.perf_event_paranoid) do not allow is just reported as
+// unavailable while the others still count. On other systems nothing is
+// available. When the kernel has to multiplex the events, counts are
+// scaled by the fraction of the time each one was running.
+
+#ifndef HASHTABLESOPENADDRESSING_PERFCOUNTERS_HPP
+#define HASHTABLESOPENADDRESSING_PERFCOUNTERS_HPP
+
+#include<array>
+#include<cstdint>
+#include<string>
+
+class PerfCounters {
+public:
+    enum EVENT {CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, DTLB_MISSES, NUM_EVENTS};
+
+    // Counts since the last start(), or -1 for an event that is unavailable.
+    using Counts = std::array<std::int64_t, NUM_EVENTS>;
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters( const PerfCounters& ) = delete;
+    PerfCounters& operator=( const PerfCounters& ) = delete;
+
+    [[nodiscard]] bool available( EVENT event ) const { return fds[event] >= 0; }
+    [[nodiscard]] bool anyAvailable() const;
+
+    // Resets and enables the counters, and disables them again. Only events
+    // of the thread that constructed this object are counted.
+    void start();
+    void stop();
+    [[nodiscard]] Counts read() const;
+
+    static std::string eventName( EVENT event );
+
+private:
+    std::array<int, NUM_EVENTS> fds;
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_PERFCOUNTERS_HPP
@@ -0,0 +1,138 @@
+// ShardedHashTableDictionary.cpp
+
+#include "ShardedHashTableDictionary.hpp"
+#include<algorithm>
+
+ShardedHashTableDictionary::ShardedHashTableDictionary(std::size_t tableSize, std::size_t shardCount,
+                                                       HashTableDictionary::PROBE_TYPE probeType, bool doCompact,
+                                                       double compactionTriggerRate,
+                                                       HashTableDictionary::COMPACTION_MODE compactionMode,
+                                                       HashTableDictionary::HASH_FUNCTION hashFunction) {
+    shardCount = std::max<std::size_t>(shardCount, 1);
+    const std::size_t shardSize = HashTableDictionary::nextPrime(std::max<std::size_t>(tableSize / shardCount, 3));
+    shards.reserve(shardCount);
+    for (std::size_t i = 0; i < shardCount; i++) {
+        shards.push_back(std::make_unique<Shard>(shardSize, probeType, doCompact, compactionTriggerRate,
+                                                 compactionMode, hashFunction));
+        shards.back()->table.setGrowthLoadFactor(DEFAULT_GROWTH_LOAD_FACTOR);
+    }
+}
+
+std::size_t ShardedHashTableDictionary::shardOf(std::string_view v) const {
+    return shardOfHash(HashTableDictionary::hash64(v));
+}
+
+std::size_t ShardedHashTableDictionary::shardOf(const HashTableDictionary::JoinedKey& key) const {
+    return shardOfHash(HashTableDictionary::hash64(key));
+}
+
+std::size_t ShardedHashTableDictionary::shardOfHash(std::uint64_t hash) const {
+    // WYHASH takes a key's home slot from the high bits of this same hash,
+    // so multiply by an odd constant first: the high bits of the product
+    // depend on all of the hash's bits.
+    const std::uint64_t mixed = hash * 0x9E3779B97F4A7C15ull;
+#if defined(__SIZEOF_INT128__)
+    return static_cast<std::size_t>((static_cast<__uint128_t>(mixed) * shards.size()) >> 64);
+#else
+    return static_cast<std::size_t>(mixed % shards.size());
+#endif
+}
+
+bool ShardedHashTableDictionary::insert(std::string_view v) {
+    return insertKey(v);
+}
+
+bool ShardedHashTableDictionary::member(std::string_view v) {
+    return memberKey(v);
+}
+
+bool ShardedHashTableDictionary::remove(std::string_view v) {
+    return removeKey(v);
+}
+
+bool ShardedHashTableDictionary::insert(const HashTableDictionary::JoinedKey& key) {
+    return insertKey(key);
+}
+
+bool ShardedHashTableDictionary::member(const HashTableDictionary::JoinedKey& key) {
+    return memberKey(key);
+}
+
+bool ShardedHashTableDictionary::remove(const HashTableDictionary::JoinedKey& key) {
+    return removeKey(key);
+}
+
+template<typename Key>
+bool ShardedHashTableDictionary::insertKey(const Key& key) {
+    Shard& shard = *shards[shardOf(key)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.table.insert(key);
+}
+
+template<typename Key>
+bool ShardedHashTableDictionary::memberKey(const Key& key) {
+    // member() updates the shard's counters, so even lookups need the lock.
+    Shard& shard = *shards[shardOf(key)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.table.member(key);
+}
+
+template<typename Key>
+bool ShardedHashTableDictionary::removeKey(const Key& key) {
+    Shard& shard = *shards[shardOf(key)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.table.remove(key);
+}
+
+std::size_t ShardedHashTableDictionary::size() const {
+    std::size_t total = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        total += shard->table.size();
+    }
+    return total;
+}
+
+std::size_t ShardedHashTableDictionary::tableSize() const {
+    std::size_t total = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        total += shard->table.tableSize();
+    }
+    return total;
+}
+
+HashTableDictionary::Counters ShardedHashTableDictionary::counters() const {
+    HashTableDictionary::Counters totals;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        totals += shard->table.counters();
+    }
+    return totals;
+}
+
+std::string ShardedHashTableDictionary::csvStats() const {
+    HashTableDictionary::Counters totals;
+    std::size_t slots = 0, bytes = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        totals += shard->table.counters();
+        slots += shard->table.tableSize();
+        bytes += shard->table.memoryBytes();
+    }
+    return shards.front()->table.csvStats(totals, slots, bytes);
+}
+
+void ShardedHashTableDictionary::setGrowthLoadFactor(double loadFactor) {
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        shard->table.setGrowthLoadFactor(loadFactor);
+    }
+}
+
+void ShardedHashTableDictionary::clear() {
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        shard->table.clear();
+    }
+}
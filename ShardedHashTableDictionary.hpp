@@ -0,0 +1,85 @@
+// ShardedHashTableDictionary.hpp
+// A HashTableDictionary split into independently locked shards, so that
+// threads working on keys in different shards do not wait for each other.
+// A key's shard comes from the high bits of a 64-bit hash that is remixed
+// so that it stays independent of the probe sequence inside the shard.
+
+#ifndef HASHTABLESOPENADDRESSING_SHARDEDHASHTABLEDICTIONARY_HPP
+#define HASHTABLESOPENADDRESSING_SHARDEDHASHTABLEDICTIONARY_HPP
+
+#include<memory>
+#include<mutex>
+#include<string>
+#include<string_view>
+#include<vector>
+
+#include "HashTableDictionary.hpp"
+
+class ShardedHashTableDictionary {
+public:
+    // tableSize is the total number of slots; each of the shardCount shards
+    // gets the next prime above its share. Keys rarely split evenly, so every
+    // shard grows automatically (setGrowthLoadFactor) once it passes
+    // DEFAULT_GROWTH_LOAD_FACTOR.
+    ShardedHashTableDictionary( std::size_t tableSize, std::size_t shardCount,
+        HashTableDictionary::PROBE_TYPE probeType, bool doCompact=false, double compactionTriggerRate=0.95,
+        HashTableDictionary::COMPACTION_MODE compactionMode=HashTableDictionary::STOP_THE_WORLD,
+        HashTableDictionary::HASH_FUNCTION hashFunction=HashTableDictionary::MODULAR );
+
+    static constexpr double DEFAULT_GROWTH_LOAD_FACTOR = 0.9;
+
+    // Safe to call from any number of threads at once; each call locks only
+    // the key's shard.
+    bool insert( std::string_view v );
+    bool member( std::string_view v );
+    bool remove( std::string_view v );
+    // Two-part keys; see HashTableDictionary::JoinedKey.
+    bool insert( const HashTableDictionary::JoinedKey& key );
+    bool member( const HashTableDictionary::JoinedKey& key );
+    bool remove( const HashTableDictionary::JoinedKey& key );
+    bool insert( std::string_view w1, std::string_view w2 ) { return insert(HashTableDictionary::JoinedKey(w1, w2)); }
+    bool member( std::string_view w1, std::string_view w2 ) { return member(HashTableDictionary::JoinedKey(w1, w2)); }
+    bool remove( std::string_view w1, std::string_view w2 ) { return remove(HashTableDictionary::JoinedKey(w1, w2)); }
+
+    // These visit the shards one at a time, so under concurrent updates
+    // the result is not a snapshot of a single instant.
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] bool empty() const { return size() == 0; }
+    [[nodiscard]] std::size_t tableSize() const;
+    [[nodiscard]] HashTableDictionary::Counters counters() const;
+    // One csvStats() row for the whole dictionary: counters and sizes summed
+    // over the shards.
+    std::string csvStats() const;
+    static std::string csvStatsHeader() { return HashTableDictionary::csvStatsHeader(); }
+
+    void setGrowthLoadFactor( double loadFactor );
+    void clear();
+
+    [[nodiscard]] std::size_t numShards() const { return shards.size(); }
+    [[nodiscard]] std::size_t shardOf( std::string_view v ) const;
+    [[nodiscard]] std::size_t shardOf( const HashTableDictionary::JoinedKey& key ) const;
+
+private:
+    // Padded to a cache line so that neighbouring shards' locks do not
+    // share one.
+    struct alignas(64) Shard {
+        template<typename... Args>
+        explicit Shard(Args&&... args) : table(std::forward<Args>(args)...) {}
+        mutable std::mutex lock;
+        HashTableDictionary table;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    [[nodiscard]] std::size_t shardOfHash( std::uint64_t hash ) const;
+    // The bodies of insert()/member()/remove() for either kind of key.
+    template<typename Key>
+    bool insertKey( const Key& key );
+    template<typename Key>
+    bool memberKey( const Key& key );
+    template<typename Key>
+    bool removeKey( const Key& key );
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_SHARDEDHASHTABLEDICTIONARY_HPP
@@ -0,0 +1,142 @@
+// SlotArray.cpp
+
+#include "SlotArray.hpp"
+#include<atomic>
+#include<cstdint>
+#include<fstream>
+#include<new>
+
+#ifdef __linux__
+#include<linux/mempolicy.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#endif
+
+namespace slotmemory {
+
+namespace {
+const std::size_t CACHE_LINE = 64;
+
+std::atomic<std::size_t> hugetlbBytes{0};
+std::atomic<std::size_t> transparentBytes{0};
+std::atomic<std::size_t> defaultPageBytes{0};
+std::atomic<std::size_t> numaFailures{0};
+
+std::shared_ptr<void> allocateOnHeap(std::size_t bytes) {
+    void *memory = ::operator new(std::max<std::size_t>(bytes, 1), std::align_val_t(CACHE_LINE));
+    return {memory, [](void *p) { ::operator delete(p, std::align_val_t(CACHE_LINE)); }};
+}
+
+#ifdef __linux__
+std::size_t roundUp(std::size_t bytes, std::size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+// The online nodes, from a list such as "0-1,4" in sysfs; node 0 if there
+// is no such list.
+unsigned long onlineNodes() {
+    std::ifstream in("/sys/devices/system/node/online");
+    unsigned long mask = 0;
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        const std::size_t dash = range.find('-');
+        try {
+            const unsigned long from = std::stoul(range.substr(0, dash));
+            const unsigned long to = dash == std::string::npos ? from : std::stoul(range.substr(dash + 1));
+            for (unsigned long node = from; node <= to && node < 8 * sizeof(mask); node++)
+                mask |= 1UL << node;
+        } catch (const std::exception&) {
+            break;
+        }
+    }
+    return mask != 0 ? mask : 1UL;
+}
+
+// Pages are only placed when first touched, so this has to run before the
+// memory is written to. A failure leaves the kernel's default placement.
+void applyNumaPolicy(void *memory, std::size_t length, const Placement& placement) {
+    unsigned long mask;
+    int mode;
+    if (placement.numa == BIND_NODE) {
+        if (placement.node < 0 || placement.node >= static_cast<int>(8 * sizeof(mask))) {
+            numaFailures++;
+            return;
+        }
+        mask = 1UL << placement.node;
+        mode = MPOL_BIND;
+    } else {
+        static const unsigned long online = onlineNodes();
+        mask = online;
+        mode = MPOL_INTERLEAVE;
+    }
+    // Called through syscall() so that libnuma is not needed.
+    if (syscall(SYS_mbind, memory, length, mode, &mask, 8 * sizeof(mask) + 1, 0) != 0)
+        numaFailures++;
+}
+
+// Anonymous memory of at least bytes, starting at a HUGE_PAGE_BYTES
+// boundary when huge pages are asked for, so that it can be backed by them.
+std::shared_ptr<void> allocateMapped(std::size_t bytes, const Placement& placement) {
+    const bool huge = placement.pages == HUGE_PAGES;
+    const std::size_t length = roundUp(bytes, huge ? HUGE_PAGE_BYTES : static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+    void *memory = MAP_FAILED;
+    if (huge) {
+        // Reserved huge pages (vm.nr_hugepages), which are never split.
+        memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+            hugetlbBytes += length;
+    }
+    if (memory == MAP_FAILED) {
+        // Otherwise map HUGE_PAGE_BYTES more than needed and trim it to an
+        // aligned range, which transparent huge pages can back.
+        const std::size_t slack = huge ? HUGE_PAGE_BYTES : 0;
+        void *mapped = mmap(nullptr, length + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            throw std::bad_alloc();
+        char *start = static_cast<char *>(mapped);
+        char *aligned = reinterpret_cast<char *>(roundUp(reinterpret_cast<std::uintptr_t>(start), huge ? HUGE_PAGE_BYTES : 1));
+        if (aligned > start)
+            munmap(start, aligned - start);
+        if (start + slack > aligned)
+            munmap(aligned + length, start + slack - aligned);
+        memory = aligned;
+        if (huge) {
+            if (madvise(memory, length, MADV_HUGEPAGE) == 0)
+                transparentBytes += length;
+            else
+                defaultPageBytes += length;
+        }
+    }
+    if (placement.numa != DEFAULT_NODES)
+        applyNumaPolicy(memory, length, placement);
+    return {memory, [length](void *p) { munmap(p, length); }};
+}
+#endif
+}
+
+std::shared_ptr<void> allocate(std::size_t bytes, const Placement& placement) {
+#ifdef __linux__
+    // An array smaller than a huge page gains nothing from one.
+    const bool huge = placement.pages == HUGE_PAGES && bytes >= HUGE_PAGE_BYTES;
+    if (huge || placement.numa != DEFAULT_NODES)
+        return allocateMapped(bytes, {huge ? HUGE_PAGES : DEFAULT_PAGES, placement.numa, placement.node});
+#endif
+    return allocateOnHeap(bytes);
+}
+
+PlacementTotals placementTotals() {
+    return {hugetlbBytes.load(), transparentBytes.load(), defaultPageBytes.load(), numaFailures.load()};
+}
+
+std::string placementName(const Placement& placement) {
+    std::string name = placement.pages == HUGE_PAGES ? "hugepages" : "";
+    if (placement.numa != DEFAULT_NODES) {
+        if (!name.empty())
+            name += "_";
+        name += placement.numa == INTERLEAVE_NODES ? "interleave" : "node" + std::to_string(placement.node);
+    }
+    return name;
+}
+
+}
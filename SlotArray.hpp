@@ -0,0 +1,165 @@
+// SlotArray.hpp
+// The arrays HashTableDictionary keeps per slot (control bytes, key cells,
+// probe distances): a std::vector-like array of trivially copyable items
+// whose memory is either allocated by the array or borrowed from elsewhere,
+// such as a snapshot file mapped by HashTableDictionary::load(). Borrowed
+// memory is kept alive by a shared owner and is only read or written in
+// place; growing past it moves the items into memory of the array's own.
+// The array's own memory can be asked for on huge pages and on particular
+// NUMA nodes (see slotmemory::Placement).
+
+#ifndef HASHTABLESOPENADDRESSING_SLOTARRAY_HPP
+#define HASHTABLESOPENADDRESSING_SLOTARRAY_HPP
+
+#include<algorithm>
+#include<cstddef>
+#include<cstring>
+#include<memory>
+#include<stdexcept>
+#include<string>
+#include<type_traits>
+#include<utility>
+
+namespace slotmemory {
+
+const std::size_t HUGE_PAGE_BYTES = std::size_t(2) << 20;
+
+// HUGE_PAGES backs arrays of at least HUGE_PAGE_BYTES with 2 MB pages:
+// reserved ones (MAP_HUGETLB) while there are any, otherwise memory aligned
+// to HUGE_PAGE_BYTES and advised for transparent huge pages, otherwise
+// plain pages. DEFAULT_NODES leaves the NUMA placement to the kernel,
+// usually the node of the thread that first touches a page; BIND_NODE
+// keeps the pages on node and INTERLEAVE_NODES spreads them round-robin
+// over the online nodes. Both are only available on Linux; elsewhere, and
+// for the defaults, memory comes from operator new.
+enum PAGE_SIZE {DEFAULT_PAGES, HUGE_PAGES};
+enum NUMA_POLICY {DEFAULT_NODES, BIND_NODE, INTERLEAVE_NODES};
+
+struct Placement {
+    PAGE_SIZE pages = DEFAULT_PAGES;
+    NUMA_POLICY numa = DEFAULT_NODES;
+    int node = 0;
+};
+
+// What allocations with huge pages asked for actually got, in bytes, and
+// the number of NUMA policies the kernel refused. Totals for the process.
+struct PlacementTotals {
+    std::size_t hugetlbBytes;
+    std::size_t transparentBytes;
+    std::size_t defaultPageBytes;
+    std::size_t numaFailures;
+};
+
+// Allocates bytes aligned to a cache line. The memory is released when the
+// last copy of the returned owner goes away.
+std::shared_ptr<void> allocate( std::size_t bytes, const Placement& placement = Placement() );
+PlacementTotals placementTotals();
+// E.g. "hugepages_interleave" or "node1"; empty for the default placement.
+std::string placementName( const Placement& placement );
+
+}
+
+template<typename T>
+class SlotArray {
+    static_assert(std::is_trivially_copyable_v<T>, "SlotArray items are copied as bytes");
+
+public:
+    SlotArray() = default;
+    SlotArray( const SlotArray& other ) : placement(other.placement) { copyFrom(other); }
+    SlotArray( SlotArray&& other ) noexcept { swap(other); }
+    SlotArray& operator=( const SlotArray& other ) {
+        if (this != &other)
+            copyFrom(other);
+        return *this;
+    }
+    SlotArray& operator=( SlotArray&& other ) noexcept {
+        SlotArray moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    [[nodiscard]] std::size_t size() const { return count; }
+    [[nodiscard]] std::size_t capacity() const { return room; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    T& operator[]( std::size_t i ) { return items[i]; }
+    const T& operator[]( std::size_t i ) const { return items[i]; }
+    const T& at( std::size_t i ) const {
+        if (i >= count)
+            throw std::out_of_range("SlotArray::at");
+        return items[i];
+    }
+
+    // As for std::vector: clear() keeps the memory, resize() keeps the
+    // first items and sets any new ones to value.
+    void clear() { count = 0; }
+    void resize( std::size_t n, const T& value = T() ) {
+        if (n > room)
+            reallocate(n);
+        std::fill(items + std::min(count, n), items + n, value);
+        count = n;
+    }
+    void assign( std::size_t n, const T& value ) {
+        clear();
+        resize(n, value);
+    }
+
+    // Uses the n items at borrowed, which owner keeps alive, instead of
+    // this array's own memory.
+    void borrow( std::shared_ptr<void> owner_, T* borrowed, std::size_t n ) {
+        owner = std::move(owner_);
+        items = borrowed;
+        count = room = n;
+    }
+
+    // Where memory this array allocates comes from. Items already held,
+    // borrowed ones included, are moved into memory placed that way.
+    void setPlacement( const slotmemory::Placement& placement_ ) {
+        placement = placement_;
+        if (room > 0)
+            reallocate(room);
+    }
+    [[nodiscard]] const slotmemory::Placement& getPlacement() const { return placement; }
+
+    void swap( SlotArray& other ) noexcept {
+        std::swap(owner, other.owner);
+        std::swap(items, other.items);
+        std::swap(count, other.count);
+        std::swap(room, other.room);
+        std::swap(placement, other.placement);
+    }
+
+private:
+    void reallocate( std::size_t n ) {
+        std::shared_ptr<void> memory = slotmemory::allocate(n * sizeof(T), placement);
+        T* moved = static_cast<T*>(memory.get());
+        if (count > 0)
+            std::memcpy(moved, items, count * sizeof(T));
+        owner = std::move(memory);
+        items = moved;
+        room = n;
+    }
+
+    void copyFrom( const SlotArray& other ) {
+        clear();
+        if (other.count > room)
+            reallocate(other.count);
+        if (other.count > 0)
+            std::memcpy(items, other.items, other.count * sizeof(T));
+        count = other.count;
+    }
+
+    std::shared_ptr<void> owner;
+    T* items = nullptr;
+    std::size_t count = 0;
+    std::size_t room = 0;
+    slotmemory::Placement placement;
+};
+
+
+#endif //HASHTABLESOPENADDRESSING_SLOTARRAY_HPP
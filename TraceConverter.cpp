@@ -0,0 +1,91 @@
+// TraceConverter.cpp
+// Converts a text trace into the binary format that TraceReader streams
+// (see TraceReader.hpp for the layout). Every distinct key is stored once
+// and each operation becomes a 4-byte opcode/key-id word.
+//
+// Usage: TraceConverter <input.trace> <output.btrace>
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "TraceReader.hpp"
+
+template<typename T>
+void write_raw(std::ofstream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.trace> <output.btrace>\n";
+        return 1;
+    }
+
+    TraceReader trace;
+    if (!trace.open(argv[1])) {
+        std::cerr << "Failed to load trace " << argv[1] << "\n";
+        return 1;
+    }
+    if (trace.isBinary()) {
+        std::cerr << argv[1] << " is already a binary trace\n";
+        return 1;
+    }
+
+    // Intern the keys in order of first appearance. The views point into
+    // the reader's mapping, which stays open until we are done.
+    std::unordered_map<std::string_view, std::uint32_t> ids;
+    std::vector<std::string_view> keys;
+    std::vector<std::uint32_t> words;
+    words.reserve(trace.size());
+    bool tooManyKeys = false;
+    trace.forEachOp([&](const Operation &op) {
+        auto [it, inserted] = ids.try_emplace(op.key, static_cast<std::uint32_t>(keys.size()));
+        if (inserted)
+            keys.push_back(op.key);
+        tooManyKeys = tooManyKeys || keys.size() > TraceReader::KEY_ID_MASK + 1ull;
+        words.push_back(static_cast<std::uint32_t>(op.tag) << TraceReader::OPCODE_SHIFT | it->second);
+    });
+    if (tooManyKeys) {
+        std::cerr << "Too many distinct keys for the binary format\n";
+        return 1;
+    }
+
+    std::ofstream out(argv[2], std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Unable to open " << argv[2] << " for writing\n";
+        return 1;
+    }
+
+    out.write(TraceReader::BINARY_MAGIC, sizeof(TraceReader::BINARY_MAGIC));
+    write_raw(out, static_cast<std::uint32_t>(trace.profile().size()));
+    out.write(trace.profile().data(), static_cast<std::streamsize>(trace.profile().size()));
+    write_raw(out, static_cast<std::uint64_t>(trace.N()));
+    write_raw(out, static_cast<std::int32_t>(trace.seed()));
+    write_raw(out, static_cast<std::uint32_t>(keys.size()));
+
+    std::uint64_t offset = 0;
+    write_raw(out, offset);
+    for (const auto &key : keys) {
+        offset += key.size();
+        write_raw(out, offset);
+    }
+    for (const auto &key : keys)
+        out.write(key.data(), static_cast<std::streamsize>(key.size()));
+
+    write_raw(out, static_cast<std::uint64_t>(words.size()));
+    out.write(reinterpret_cast<const char *>(words.data()),
+              static_cast<std::streamsize>(words.size() * sizeof(std::uint32_t)));
+
+    if (!out) {
+        std::cerr << "Failed writing " << argv[2] << "\n";
+        return 1;
+    }
+    std::cout << argv[1] << ": " << words.size() << " operations, "
+              << keys.size() << " distinct keys -> " << argv[2] << "\n";
+    return 0;
+}
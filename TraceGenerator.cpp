@@ -0,0 +1,353 @@
+// TraceGenerator.cpp
+// Writes synthetic traces in the text format TraceReader loads: a
+// "<profile> <N> <seed>" header, then one "I w1 w2", "E w1 w2" or
+// "L w1 w2" line per operation. Keys are distinct pairs of words from a
+// word list. The same arguments always produce the same file: all
+// randomness comes from std::mt19937_64, whose output the standard fixes,
+// through the conversions in Random rather than the library-specific std
+// distributions.
+//
+// Profiles (N is the number of keys the table is meant to hold):
+//   lru     An LRU cache of N keys. Each access picks one of --universe * N
+//           keys uniformly; a hit re-inserts the key, a miss evicts the least
+//           recently used key (E) when the cache is full and inserts (I).
+//           --ops * N accesses. The provided lru_profile traces have this
+//           shape.
+//   zipf    The same cache, with accesses following a Zipf distribution of
+//           exponent --zipf over the keys.
+//   bulk    Inserts fresh keys until N are present; before each insert, with
+//           probability --mix percent, a random present key is erased.
+//   drain   Inserts N keys, then erases random present keys until none is
+//           left; before each erase, with probability --mix percent, a random
+//           erased key is inserted again.
+//   lookup  Inserts N of 2N keys, then performs --ops * N operations: with
+//           probability --mix percent a lookup (L) of any of the 2N keys,
+//           and otherwise an erase of a present key followed by an insert of
+//           an absent one.
+//
+// Usage: TraceGenerator <profile> <N> <seed> <output.trace> [--words <file>]
+//                       [--ops <per-key>] [--universe <factor>] [--zipf <s>] [--mix <percent>]
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string profile;
+    std::size_t N = 0;
+    std::uint32_t seed = 0;     // the header's seed is read as an int
+    std::string outputPath;
+    std::string wordsPath = std::string(HASH_TABLE_WORDS_DIR) + "/6770_uniq_words.txt";
+    double opsPerKey = 12.0;
+    double universe = 4.0;
+    double zipf = 0.99;
+    double mixPercent = -1.0;   // per-profile default when not given
+};
+
+class Random {
+public:
+    explicit Random(std::uint64_t seed) : engine(seed) {}
+
+    // Uniform in [0, n), by multiply-shift range reduction.
+    std::size_t below(std::size_t n) {
+        return static_cast<std::size_t>((static_cast<__uint128_t>(engine()) * n) >> 64);
+    }
+    // Uniform in [0, 1), from the top 53 bits.
+    double unit() { return static_cast<double>(engine() >> 11) * 0x1.0p-53; }
+    bool percent(double p) { return unit() * 100.0 < p; }
+
+private:
+    std::mt19937_64 engine;
+};
+
+// A set of key ids in [0, universe) with O(1) insert, erase and uniformly
+// random choice of a member.
+class IdSet {
+public:
+    explicit IdSet(std::size_t universe) : position(universe, NONE) {}
+
+    [[nodiscard]] std::size_t size() const { return members.size(); }
+    [[nodiscard]] bool empty() const { return members.empty(); }
+
+    void insert(std::uint32_t id) {
+        position[id] = static_cast<std::uint32_t>(members.size());
+        members.push_back(id);
+    }
+    void erase(std::uint32_t id) {
+        const std::uint32_t last = members.back();
+        members[position[id]] = last;
+        position[last] = position[id];
+        members.pop_back();
+        position[id] = NONE;
+    }
+    std::uint32_t pick(Random &random) const { return members[random.below(members.size())]; }
+
+private:
+    static constexpr std::uint32_t NONE = UINT32_MAX;
+    std::vector<std::uint32_t> members;
+    std::vector<std::uint32_t> position;
+};
+
+// count distinct "w1 w2" keys, in random order.
+std::vector<std::string> makeKeys(const std::vector<std::string> &words, std::size_t count, Random &random) {
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    while (keys.size() < count) {
+        std::string key = words[random.below(words.size())] + " " + words[random.below(words.size())];
+        if (seen.insert(key).second)
+            keys.push_back(std::move(key));
+    }
+    return keys;
+}
+
+class TraceWriter {
+public:
+    TraceWriter(std::ofstream &out, const std::vector<std::string> &keys) : out(out), keys(keys) {}
+    void insert(std::uint32_t id) { write('I', id); }
+    void erase(std::uint32_t id) { write('E', id); }
+    void lookup(std::uint32_t id) { write('L', id); }
+    [[nodiscard]] std::size_t size() const { return numOps; }
+
+private:
+    void write(char op, std::uint32_t id) {
+        out << op << ' ' << keys[id] << '\n';
+        numOps++;
+    }
+    std::ofstream &out;
+    const std::vector<std::string> &keys;
+    std::size_t numOps = 0;
+};
+
+// Cumulative Zipf(s) probabilities of ranks 1..n.
+std::vector<double> zipfCdf(std::size_t n, double s) {
+    std::vector<double> cdf(n);
+    double total = 0.0;
+    for (std::size_t rank = 0; rank < n; rank++) {
+        total += 1.0 / std::pow(static_cast<double>(rank + 1), s);
+        cdf[rank] = total;
+    }
+    for (double &p : cdf)
+        p /= total;
+    return cdf;
+}
+
+void generateLru(TraceWriter &trace, const Options &options, std::size_t numKeys, Random &random) {
+    std::vector<double> cdf;
+    if (options.profile == "zipf")
+        cdf = zipfCdf(numKeys, options.zipf);
+
+    std::list<std::uint32_t> recency;       // most recently used first
+    std::vector<std::list<std::uint32_t>::iterator> where(numKeys);
+    std::vector<bool> cached(numKeys, false);
+    const auto accesses = static_cast<std::size_t>(options.opsPerKey * static_cast<double>(options.N));
+    for (std::size_t a = 0; a < accesses; a++) {
+        std::uint32_t id;
+        if (cdf.empty()) {
+            id = static_cast<std::uint32_t>(random.below(numKeys));
+        } else {
+            // Keys are in random order, so rank r is simply key r.
+            const auto rank = std::lower_bound(cdf.begin(), cdf.end(), random.unit()) - cdf.begin();
+            id = static_cast<std::uint32_t>(std::min<std::size_t>(static_cast<std::size_t>(rank), numKeys - 1));
+        }
+        if (cached[id]) {
+            recency.erase(where[id]);
+        } else {
+            if (recency.size() == options.N) {
+                const std::uint32_t victim = recency.back();
+                recency.pop_back();
+                cached[victim] = false;
+                trace.erase(victim);
+            }
+            cached[id] = true;
+        }
+        recency.push_front(id);
+        where[id] = recency.begin();
+        trace.insert(id);
+    }
+}
+
+void generateBulk(TraceWriter &trace, const Options &options, std::size_t numKeys, Random &random) {
+    IdSet present(numKeys);
+    std::uint32_t nextFresh = 0;
+    while (present.size() < options.N && nextFresh < numKeys) {
+        if (!present.empty() && random.percent(options.mixPercent)) {
+            const std::uint32_t id = present.pick(random);
+            present.erase(id);
+            trace.erase(id);
+        }
+        present.insert(nextFresh);
+        trace.insert(nextFresh++);
+    }
+}
+
+void generateDrain(TraceWriter &trace, const Options &options, std::size_t numKeys, Random &random) {
+    IdSet present(numKeys), erased(numKeys);
+    for (std::uint32_t id = 0; id < options.N; id++) {
+        present.insert(id);
+        trace.insert(id);
+    }
+    while (!present.empty()) {
+        if (!erased.empty() && random.percent(options.mixPercent)) {
+            const std::uint32_t id = erased.pick(random);
+            erased.erase(id);
+            present.insert(id);
+            trace.insert(id);
+        }
+        const std::uint32_t id = present.pick(random);
+        present.erase(id);
+        erased.insert(id);
+        trace.erase(id);
+    }
+}
+
+void generateLookup(TraceWriter &trace, const Options &options, std::size_t numKeys, Random &random) {
+    IdSet present(numKeys), absent(numKeys);
+    for (std::uint32_t id = 0; id < numKeys; id++) {
+        if (id < options.N) {
+            present.insert(id);
+            trace.insert(id);
+        } else {
+            absent.insert(id);
+        }
+    }
+    const auto numOps = static_cast<std::size_t>(options.opsPerKey * static_cast<double>(options.N));
+    for (std::size_t op = 0; op < numOps; op++) {
+        if (random.percent(options.mixPercent) || present.empty() || absent.empty()) {
+            trace.lookup(static_cast<std::uint32_t>(random.below(numKeys)));
+            continue;
+        }
+        const std::uint32_t out = present.pick(random), in = absent.pick(random);
+        present.erase(out);
+        absent.insert(out);
+        trace.erase(out);
+        absent.erase(in);
+        present.insert(in);
+        trace.insert(in);
+    }
+}
+
+// Parses all of text as a number within [min, max] into value. Otherwise
+// says what name expects and returns false.
+template<typename T>
+bool parseNumber(const std::string &name, const std::string &text, T min, T max, T &value) {
+    const char *end = text.data() + text.size();
+    T parsed{};
+    const auto [ptr, ec] = std::from_chars(text.data(), end, parsed);
+    // NaN fails both comparisons.
+    if (ec == std::errc() && ptr == end && parsed >= min && parsed <= max) {
+        value = parsed;
+        return true;
+    }
+    std::cerr << name << " expects a number from " << min << " to " << max << ", not '" << text << "'\n";
+    return false;
+}
+
+bool parseArguments(int argc, char *argv[], Options &options) {
+    std::vector<std::string> positional;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--words")
+            options.wordsPath = argv[++i];
+        else if (i + 1 < argc && arg == "--ops")
+            valid &= parseNumber(arg, argv[++i], 0.0, 1e6, options.opsPerKey);
+        else if (i + 1 < argc && arg == "--universe")
+            valid &= parseNumber(arg, argv[++i], 1.0, 1e6, options.universe);
+        else if (i + 1 < argc && arg == "--zipf")
+            valid &= parseNumber(arg, argv[++i], 0.0, 100.0, options.zipf);
+        else if (i + 1 < argc && arg == "--mix")
+            valid &= parseNumber(arg, argv[++i], 0.0, 100.0, options.mixPercent);
+        else
+            positional.push_back(arg);
+    }
+    if (!valid || positional.size() != 4)
+        return false;
+    options.profile = positional[0];
+    // Keys are numbered with 32-bit ids, and the header's seed is an int.
+    std::uint32_t seed = 0;
+    if (!parseNumber<std::size_t>("N", positional[1], 1, UINT32_MAX, options.N) ||
+        !parseNumber<std::uint32_t>("seed", positional[2], 0, INT32_MAX, seed))
+        return false;
+    options.seed = seed;
+    options.outputPath = positional[3];
+    if (options.mixPercent < 0.0)
+        options.mixPercent = options.profile == "lookup" ? 90.0 : 10.0;
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    const std::vector<std::string> profiles = {"lru", "zipf", "bulk", "drain", "lookup"};
+    if (!parseArguments(argc, argv, options) ||
+        std::find(profiles.begin(), profiles.end(), options.profile) == profiles.end()) {
+        std::cerr << "Usage: " << argv[0] << " <profile> <N> <seed> <output.trace> [--words <file>]\n"
+                  << "       [--ops <per-key>] [--universe <factor>] [--zipf <s>] [--mix <percent>]\n"
+                  << "  profile: lru, zipf, bulk, drain or lookup (see TraceGenerator.cpp)\n"
+                  << "Example: " << argv[0] << " lru 1048576 23 lru_profile_N_1048576_S_23.trace\n";
+        return 1;
+    }
+
+    std::ifstream wordsIn(options.wordsPath);
+    if (!wordsIn.is_open()) {
+        std::cerr << "Unable to open " << options.wordsPath << "\n";
+        return 1;
+    }
+    std::vector<std::string> words;
+    for (std::string word; wordsIn >> word; )
+        words.push_back(word);
+
+    std::size_t numKeys = options.N;
+    if (options.profile == "lru" || options.profile == "zipf")
+        numKeys = static_cast<std::size_t>(options.universe * static_cast<double>(options.N));
+    else if (options.profile == "lookup")
+        numKeys = 2 * options.N;
+    else if (options.profile == "bulk")    // erased keys are not inserted again
+        numKeys = static_cast<std::size_t>(static_cast<double>(options.N) * 1.1 /
+                                           (1.0 - std::min(options.mixPercent, 90.0) / 100.0)) + 16;
+    if (words.empty() || static_cast<double>(numKeys) > 0.5 * static_cast<double>(words.size()) *
+                                                     static_cast<double>(words.size())) {
+        std::cerr << options.wordsPath << " has too few words for " << numKeys << " distinct keys\n";
+        return 1;
+    }
+
+    Random random(options.seed);
+    const std::vector<std::string> keys = makeKeys(words, numKeys, random);
+
+    std::ofstream out(options.outputPath);
+    if (!out.is_open()) {
+        std::cerr << "Unable to open " << options.outputPath << " for writing\n";
+        return 1;
+    }
+    out << options.profile << "_profile " << options.N << " " << options.seed << "\n";
+
+    TraceWriter trace(out, keys);
+    if (options.profile == "lru" || options.profile == "zipf")
+        generateLru(trace, options, numKeys, random);
+    else if (options.profile == "bulk")
+        generateBulk(trace, options, numKeys, random);
+    else if (options.profile == "drain")
+        generateDrain(trace, options, numKeys, random);
+    else
+        generateLookup(trace, options, numKeys, random);
+
+    if (!out) {
+        std::cerr << "Failed writing " << options.outputPath << "\n";
+        return 1;
+    }
+    std::cout << options.outputPath << ": " << options.profile << " profile, N = " << options.N
+              << ", " << trace.size() << " operations over " << numKeys << " keys\n";
+    return 0;
+}
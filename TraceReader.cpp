@@ -0,0 +1,216 @@
+// TraceReader.cpp
+
+#include "TraceReader.hpp"
+
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// The characters operator>> treats as separators.
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// Removes and returns the next whitespace-delimited token of line; empty
+// if there is none.
+std::string_view nextToken(std::string_view &line) {
+    std::size_t begin = 0;
+    while (begin < line.size() && isSpace(line[begin]))
+        begin++;
+    std::size_t end = begin;
+    while (end < line.size() && !isSpace(line[end]))
+        end++;
+    const std::string_view token = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    return token;
+}
+
+}
+
+TraceReader::~TraceReader() {
+    unmap();
+}
+
+void TraceReader::unmap() {
+    if (mapped != nullptr)
+        munmap(const_cast<char *>(mapped), mappedLength);
+    mapped = nullptr;
+    mappedLength = 0;
+}
+
+bool TraceReader::open(const std::string &path) {
+    unmap();
+    ops.clear();
+    rebuiltKeys.clear();
+    profileName.clear();
+    numKeys = 0;
+    seedValue = 0;
+    binary = false;
+    numBinaryOps = 0;
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+    mapped = static_cast<const char *>(addr);
+    mappedLength = static_cast<std::size_t>(st.st_size);
+    madvise(addr, mappedLength, MADV_SEQUENTIAL);
+
+    if (mappedLength >= sizeof(BINARY_MAGIC) && std::memcmp(mapped, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0)
+        return binary = parseBinary();
+
+    // Lines end at '\n'; the last one may not.
+    std::string_view rest(mapped, mappedLength);
+    auto nextLine = [&rest]() {
+        const std::size_t end = rest.find('\n');
+        const std::string_view line = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+        return line;
+    };
+
+    if (!parseHeader(nextLine()))
+        return false;
+
+    // A rough count of lines, so that ops is sized once for typical traces.
+    ops.reserve(mappedLength / 16);
+    while (!rest.empty()) {
+        if (!parseOperation(nextLine()))
+            return false;
+    }
+    return true;
+}
+
+bool TraceReader::parseHeader(std::string_view line) {
+    // Since this is the first line, we don't expect it to be blank
+    // or start with a comment.
+    const auto first = line.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos || line[first] == '#')
+        return false;
+
+    std::istringstream hdr{std::string(line)};
+    return static_cast<bool>(hdr >> profileName >> numKeys >> seedValue);
+}
+
+bool TraceReader::parseOperation(std::string_view line) {
+    const auto opCodeIdx = line.find_first_not_of(" \t\r\n");
+    if (opCodeIdx == std::string_view::npos || line[opCodeIdx] == '#')
+        return true; // skip blank and comment lines.
+
+    line.remove_prefix(opCodeIdx);
+    const std::string_view tok = nextToken(line);
+    OpCode tag;
+    if (tok == "I") {
+        tag = OpCode::Insert;
+    } else if (tok == "E") {
+        tag = OpCode::Erase;
+    } else if (tok == "L") {
+        tag = OpCode::Lookup;
+    } else {
+        std::cout << "Unknown operation in TraceReader: " << tok << std::endl;
+        return false; // unknown token
+    }
+
+    const std::string_view w1 = nextToken(line);
+    const std::string_view w2 = nextToken(line);
+    if (w1.empty() || w2.empty())
+        return false;
+    ops.emplace_back(tag, joinedKey(w1, w2));
+    return true;
+}
+
+std::string_view TraceReader::joinedKey(std::string_view w1, std::string_view w2) {
+    // With a single space between the words, the key is already in the
+    // mapping and is used in place.
+    const std::string_view inPlace = joinedInPlace(w1, w2);
+    if (inPlace.data() != nullptr)
+        return inPlace;
+    rebuiltKeys.emplace_back(w1);
+    rebuiltKeys.back().append(" ").append(w2);
+    return rebuiltKeys.back();
+}
+
+bool TraceReader::parseBinary() {
+    // Checks every size and key id against the mapping once, so that
+    // decodeChunk() can trust them.
+    std::size_t pos = sizeof(BINARY_MAGIC);
+    auto take = [this, &pos](void *out, std::size_t bytes) {
+        if (mappedLength - pos < bytes)
+            return false;
+        std::memcpy(out, mapped + pos, bytes);
+        pos += bytes;
+        return true;
+    };
+    auto skip = [this, &pos](const char *&at, std::uint64_t count, std::size_t width) {
+        if (count > (mappedLength - pos) / width)
+            return false;
+        at = mapped + pos;
+        pos += static_cast<std::size_t>(count) * width;
+        return true;
+    };
+
+    std::uint32_t profileLength = 0;
+    std::uint64_t n = 0;
+    std::int32_t seed = 0;
+    const char *profileBytes = nullptr;
+    if (!take(&profileLength, sizeof(profileLength)) || !skip(profileBytes, profileLength, 1) ||
+        !take(&n, sizeof(n)) || !take(&seed, sizeof(seed)) ||
+        !take(&numBinaryKeys, sizeof(numBinaryKeys)) ||
+        numBinaryKeys > KEY_ID_MASK + 1ull ||
+        !skip(keyOffsets, numBinaryKeys + 1ull, sizeof(std::uint64_t)))
+        return false;
+    profileName.assign(profileBytes, profileLength);
+    numKeys = static_cast<std::size_t>(n);
+    seedValue = seed;
+
+    std::uint64_t previous = 0;
+    for (std::uint32_t id = 0; id <= numBinaryKeys; id++) {
+        std::uint64_t offset;
+        std::memcpy(&offset, keyOffsets + id * sizeof(offset), sizeof(offset));
+        if (offset < previous)
+            return false;
+        previous = offset;
+    }
+    std::uint64_t numOps = 0;
+    if (!skip(keyBytes, previous, 1) || !take(&numOps, sizeof(numOps)) ||
+        !skip(binaryOps, numOps, sizeof(std::uint32_t)) || pos != mappedLength)
+        return false;
+    numBinaryOps = static_cast<std::size_t>(numOps);
+
+    for (std::size_t i = 0; i < numBinaryOps; i++) {
+        std::uint32_t word;
+        std::memcpy(&word, binaryOps + i * sizeof(word), sizeof(word));
+        if ((word & KEY_ID_MASK) >= numBinaryKeys || (word >> OPCODE_SHIFT) > static_cast<unsigned>(OpCode::Lookup))
+            return false;
+    }
+    return true;
+}
+
+std::string_view TraceReader::binaryKey(std::uint32_t id) const {
+    std::uint64_t range[2];
+    std::memcpy(range, keyOffsets + id * sizeof(std::uint64_t), sizeof(range));
+    return {keyBytes + range[0], static_cast<std::size_t>(range[1] - range[0])};
+}
+
+void TraceReader::decodeChunk(std::size_t first, std::vector<Operation> &chunk) const {
+    chunk.clear();
+    const std::size_t last = std::min(numBinaryOps, first + CHUNK_OPS);
+    for (std::size_t i = first; i < last; i++) {
+        std::uint32_t word;
+        std::memcpy(&word, binaryOps + i * sizeof(word), sizeof(word));
+        chunk.emplace_back(static_cast<OpCode>(word >> OPCODE_SHIFT), binaryKey(word & KEY_ID_MASK));
+    }
+}
@@ -0,0 +1,117 @@
+// TraceReader.hpp
+// Trace loader shared by main.cpp and LRUHarness.cpp.
+// Maps the trace file read-only. The keys of the Operations it hands out
+// point into the mapping, so the reader must outlive them.
+//
+// Text traces are parsed in one pass when opened.
+// The first line of the header must contain:  <profile> <N> <seed>
+// After the header: blank lines and lines starting with '#' are ignored.
+// Opcodes: I <word1> <word2>  | E <word1> <word2>  | L <word1> <word2>
+// The two words form the key "<word1> <word2>".
+//
+// Binary traces (written by TraceConverter) are decoded CHUNK_OPS
+// operations at a time while they are replayed, so only the key
+// dictionary and one chunk are ever in memory. Layout, little-endian:
+//   char     magic[8]              "HTTRACE1"
+//   uint32   profileLength, then profileLength bytes of profile
+//   uint64   N
+//   int32    seed
+//   uint32   numKeys
+//   uint64   keyOffsets[numKeys + 1]    into the key bytes that follow
+//   char     keyBytes[keyOffsets[numKeys]]
+//   uint64   numOps
+//   uint32   ops[numOps]           OpCode in the top 2 bits, key id below
+
+#ifndef HASHTABLESOPENADDRESSING_TRACEREADER_HPP
+#define HASHTABLESOPENADDRESSING_TRACEREADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#include "Operations.hpp"
+
+class TraceReader {
+public:
+    static constexpr char BINARY_MAGIC[8] = {'H', 'T', 'T', 'R', 'A', 'C', 'E', '1'};
+    static constexpr unsigned OPCODE_SHIFT = 30;
+    static constexpr std::uint32_t KEY_ID_MASK = (1u << OPCODE_SHIFT) - 1;
+    static constexpr std::size_t CHUNK_OPS = 4096;
+
+    TraceReader() = default;
+    explicit TraceReader(const std::string &path) { open(path); }
+    ~TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    // Returns false if the file cannot be mapped, the header is missing or
+    // malformed, or an operation is. Replaces anything read before.
+    bool open(const std::string &path);
+
+    [[nodiscard]] const std::string &profile() const { return profileName; }
+    [[nodiscard]] std::size_t N() const { return numKeys; }
+    [[nodiscard]] int seed() const { return seedValue; }
+    [[nodiscard]] bool isBinary() const { return binary; }
+    // Number of operations in the trace.
+    [[nodiscard]] std::size_t size() const { return binary ? numBinaryOps : ops.size(); }
+
+    // Calls visit(const Operation *ops, std::size_t count) for consecutive
+    // runs of at most CHUNK_OPS operations, in trace order. Each call decodes
+    // into its own buffer, so several threads may replay one reader at once.
+    template<typename Visit>
+    void forEachChunk(Visit visit) const {
+        if (!binary) {
+            for (std::size_t first = 0; first < ops.size(); first += CHUNK_OPS)
+                visit(ops.data() + first, std::min(CHUNK_OPS, ops.size() - first));
+            return;
+        }
+        std::vector<Operation> chunk;
+        chunk.reserve(CHUNK_OPS);
+        for (std::size_t first = 0; first < numBinaryOps; first += CHUNK_OPS) {
+            decodeChunk(first, chunk);
+            visit(chunk.data(), chunk.size());
+        }
+    }
+    // Calls visit(const Operation &op) for every operation, in trace order.
+    template<typename Visit>
+    void forEachOp(Visit visit) const {
+        forEachChunk([&visit](const Operation *first, std::size_t count) {
+            for (std::size_t i = 0; i < count; i++)
+                visit(first[i]);
+        });
+    }
+
+private:
+    void unmap();
+    bool parseHeader(std::string_view line);
+    bool parseOperation(std::string_view line);
+    std::string_view joinedKey(std::string_view w1, std::string_view w2);
+    bool parseBinary();
+    void decodeChunk(std::size_t first, std::vector<Operation> &chunk) const;
+    [[nodiscard]] std::string_view binaryKey(std::uint32_t id) const;
+
+    const char *mapped = nullptr;
+    std::size_t mappedLength = 0;
+
+    std::string profileName;
+    std::size_t numKeys = 0;
+    int seedValue = 0;
+    std::vector<Operation> ops;
+    // Keys whose two words are not separated by exactly one space, and so
+    // do not appear verbatim in the file. A deque keeps their addresses stable.
+    std::deque<std::string> rebuiltKeys;
+
+    bool binary = false;
+    std::uint32_t numBinaryKeys = 0;
+    const char *keyOffsets = nullptr;       // uint64[numBinaryKeys + 1], unaligned
+    const char *keyBytes = nullptr;
+    std::size_t numBinaryOps = 0;
+    const char *binaryOps = nullptr;        // uint32[numBinaryOps], unaligned
+};
+
+#endif //HASHTABLESOPENADDRESSING_TRACEREADER_HPP
@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "HashTableDictionary.hpp"
+#include<chrono>
 #include<fstream>
 #include<random>
 
@@ -9,71 +10,7 @@
 #include <sstream>
 
 #include "Operations.hpp"
-
-// The first line of the header must contain:  <profile> <N> <seed>
-// After the header: blank lines and lines starting with '#' are okay
-// and will be ignored.
-// Opcodes: I <key>  | E <key
-
-bool load_trace_strict_header(const std::string &path,
-    std::size_t &N,
-                              std::vector<Operation> &out_operations) {
-    std::string profile = "";
-    int seed = 0;
-    out_operations.clear();
-
-    std::ifstream in(path);
-    if (!in.is_open())
-        return false;
-
-    // --- read FIRST line as header
-    std::string header;
-    if (!std::getline(in, header))
-        return false;
-
-    // Look for a non-while-space character
-    const auto first = header.find_first_not_of(" \t\r\n");
-    // Since this is the first line, we don't expect it to be blank
-    // or start with a comment.
-    if (first == std::string::npos || header[first] == '#')
-        return false;
-
-    // Create a string stream so that we can read the profile name,
-    // N, and the seed more easily.
-    std::istringstream hdr(header);
-    if (!(hdr >> profile >> N >> seed))
-        return false;
-
-
-    // --- read ops, allowing comments/blank lines AFTER the header ---
-    std::string line;
-    while (std::getline(in, line)) {
-        const auto opCodeIdx = line.find_first_not_of(" \t\r\n");
-        if (opCodeIdx == std::string::npos || line[opCodeIdx] == '#')
-            continue; // skip blank and comment lines.
-
-        std::istringstream iss(line.substr(opCodeIdx));
-        std::string tok; //
-        if (!(iss >> tok))
-            continue;
-
-        std::string w1, w2; // there are two words after the op code.
-                            // Maybe we should add a dash in between in the data file.
-        if (tok == "I") {
-            if (!(iss >> w1 >> w2)) return false;
-            out_operations.emplace_back(OpCode::Insert, w1.append(" ") + w2);
-        } else if (tok == "E") {
-            if (!(iss >> w1 >> w2)) return false;
-//            std::cout << "w1 = " << w1 << " w2 = " << w2 << std::endl;
-            out_operations.emplace_back(OpCode::Erase, w1.append(" ") + w2);
-        } else {
-            std::cout << "Unknown operation in load_trace_strict_header: " << tok << std::endl;
-            return false; // unknown token
-        }
-    }
-
-    return true;
-}
+#include "TraceReader.hpp"
 
 std::size_t tableSizeForN(std::size_t N) {
    static const std::vector<std::pair<std::size_t, std::size_t>> N_and_primes = {
@@ -94,49 +31,104 @@ std::size_t tableSizeForN(std::size_t N) {
         if (item.first == N)
             return item.second;
     }
-    std::cout << "Unable to find table size for " << N << " in RunMetaData." << std::endl;
-    exit(1);
+    // Other Ns, e.g. of generated traces: the first prime past N / 0.8,
+    // about the same load factor as the listed sizes.
+    return HashTableDictionary::nextPrime(N + N / 4);
 }
 
 
 int main(int argc, char *argv[]) {
 
 
-    if( argc != 2 ) {
-        std::cout << "usage: " << argv[0] << " nameOfInputFile\n";
-        exit(1);
+    // --maps also prints the table's slot maps, which run to millions of
+    // characters for the larger traces; by default their cluster statistics
+    // are printed instead. --save writes the table to a snapshot file once
+    // the trace is replayed, and --load restores a snapshot instead of
+    // replaying a trace (see HashTableDictionary::save()); --check makes it
+    // check every cell of the snapshot first.
+    bool printMaps = false;
+    auto snapshotCheck = HashTableDictionary::CHECK_LAYOUT;
+    std::string tracePath, savePath, loadPath;
+    bool badArguments = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--maps")
+            printMaps = true;
+        else if (arg == "--save" && i + 1 < argc)
+            savePath = argv[++i];
+        else if (arg == "--load" && i + 1 < argc)
+            loadPath = argv[++i];
+        else if (arg == "--check")
+            snapshotCheck = HashTableDictionary::CHECK_CELLS;
+        else if (tracePath.empty() && arg.rfind("--", 0) != 0)
+            tracePath = arg;
+        else
+            badArguments = true;
     }
-
-    std::fstream inputStream;
-    inputStream.open(argv[1], std::ios::in);
-    if( !inputStream.is_open() ) {
-        std::cout << "Unable to open " << argv[1] << ". Terminating...\n";
-        exit(2);
+    if( badArguments || tracePath.empty() == loadPath.empty() ) {
+        std::cout << "usage: " << argv[0] << " nameOfInputFile [--maps] [--save snapshotFile]\n"
+                  << "       " << argv[0] << " --load snapshotFile [--check] [--maps] [--save snapshotFile]\n";
+        exit(1);
     }
 
-
-    std::vector<Operation> operations;
+    // Binary traces are streamed a chunk at a time; see TraceReader.
+    TraceReader trace;
     std::size_t N = 0;
-    load_trace_strict_header(std::string(argv[1]), N, operations);
+    if (!tracePath.empty()) {
+        std::fstream inputStream;
+        inputStream.open(tracePath, std::ios::in);
+        if( !inputStream.is_open() ) {
+            std::cout << "Unable to open " << tracePath << ". Terminating...\n";
+            exit(2);
+        }
+        if (!trace.open(tracePath)) {
+            std::cerr << "Failed to load trace " << tracePath << "\n";
+            exit(1);
+        }
+        N = trace.N();
+    }
 
     HashTableDictionary::PROBE_TYPE pType = HashTableDictionary::DOUBLE;
     auto doWePerformCompaction = true;
+    // A loaded snapshot brings its own table size and settings.
     HashTableDictionary hashDictionary(
-            tableSizeForN(N), pType, doWePerformCompaction);
-
-    hashDictionary.clear();
-    std::cout << "Starting a run with N = " << N << " and " << operations.size() << " operations." << std::endl;
-    for (const auto &op: operations) {
-        // op.print();
-
-        switch (op.tag) {
-            case OpCode::Insert:
-                hashDictionary.insert(op.key);
-                break;
-            case OpCode::Erase:
-                (void) hashDictionary.remove(op.key);
-                break;
+            loadPath.empty() ? tableSizeForN(N) : 1, pType, doWePerformCompaction);
+    hashDictionary.setVerbose(true);  // keep the compaction log and before/after maps
+
+    if (!loadPath.empty()) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!hashDictionary.load(loadPath, snapshotCheck)) {
+            std::cout << "Unable to load snapshot " << loadPath << ". Terminating...\n";
+            exit(2);
         }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Loaded " << hashDictionary.size() << " keys from " << loadPath << " in "
+                  << elapsed.count() << " ms." << std::endl;
+    } else {
+        hashDictionary.clear();
+        std::cout << "Starting a run with N = " << N << " and " << trace.size() << " operations." << std::endl;
+        trace.forEachOp([&hashDictionary](const Operation &op) {
+            // op.print();
+
+            switch (op.tag) {
+                case OpCode::Insert:
+                    hashDictionary.insert(op.key);
+                    break;
+                case OpCode::Erase:
+                    (void) hashDictionary.remove(op.key);
+                    break;
+                case OpCode::Lookup:
+                    (void) hashDictionary.member(op.key);
+                    break;
+            }
+        });
+    }
+    if (!savePath.empty()) {
+        if (!hashDictionary.save(savePath)) {
+            std::cout << "Unable to write snapshot " << savePath << ". Terminating...\n";
+            exit(2);
+        }
+        std::cout << "Saved the table to " << savePath << "." << std::endl;
     }
     std::cout << "in run trace printing csv.\n";
     std::cout << HashTableDictionary::csvStatsHeader() << std::endl;
@@ -144,9 +136,16 @@ int main(int argc, char *argv[]) {
     std::cout << "in run trace printing csv ends.\n";
 
 
+    if (!printMaps) {
+        hashDictionary.printStats();
+        std::cout << hashDictionary.structureStatsJson() << std::endl;
+        return 0;
+    }
+
     hashDictionary.printMask();
     hashDictionary.printStats();
-    if (doWePerformCompaction)
+    // A loaded table has no record of its last compaction.
+    if (doWePerformCompaction && loadPath.empty())
         hashDictionary.printBeforeAndAfterCompactionMaps();
     else
         hashDictionary.printActiveDeleteMap();